@@ -0,0 +1,150 @@
+#include "accumulator.h"
+
+#include <algorithm>
+#include <cstring>
+
+Accumulator::Accumulator() {
+	mode = BLEND_MEAN;
+	alpha = 0.0f;
+	dims = glm::ivec3(0);
+	bricks = glm::ivec3(0);
+}
+
+void Accumulator::enable(glm::ivec3 dims, BlendMode mode, float alpha) {
+	disable();
+
+	this->dims = dims;
+	this->mode = mode;
+	this->alpha = alpha;
+
+	bricks = (dims + BRICK_SIZE - 1) / BRICK_SIZE;
+
+	size_t count = size_t(bricks.x) * bricks.y * bricks.z;
+	brickSlots.assign(count, 0);
+	touched.assign(count, 0);
+}
+
+void Accumulator::disable() {
+	// Swapping with empty vectors frees the memory, which clear() would not
+	std::vector<uint32_t>().swap(brickSlots);
+	std::vector<float>().swap(sums);
+	std::vector<float>().swap(weights);
+	std::vector<uint32_t>().swap(freeSlots);
+	std::vector<uint8_t>().swap(touched);
+}
+
+uint32_t Accumulator::allocateBrick(size_t brick) {
+	uint32_t slot;
+
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+
+		std::fill_n(sums.begin() + size_t(slot - 1) * BRICK_VOXELS, BRICK_VOXELS, 0.0f);
+		std::fill_n(weights.begin() + size_t(slot - 1) * BRICK_VOXELS, BRICK_VOXELS, 0.0f);
+	}
+	else {
+		slot = uint32_t(sums.size() / BRICK_VOXELS) + 1;
+
+		sums.resize(sums.size() + BRICK_VOXELS, 0.0f);
+		weights.resize(weights.size() + BRICK_VOXELS, 0.0f);
+	}
+
+	brickSlots[brick] = slot;
+	return slot;
+}
+
+bool Accumulator::resolve(int x, int y, int z, float& value) const {
+	uint32_t slot = brickSlots[brickIndex(x, y, z)];
+
+	if (slot == 0) {
+		return false;
+	}
+
+	size_t i = size_t(slot - 1) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+	float total = weights[i];
+
+	if (total <= 0.0f) {
+		return false;
+	}
+
+	// The moving average is the sum itself
+	value = mode == BLEND_EMA ? sums[i] : sums[i] / total;
+	return true;
+}
+
+std::vector<size_t> Accumulator::takeTouchedBricks() {
+	std::vector<size_t> result;
+
+	for (size_t brick = 0; brick < touched.size(); brick++) {
+		if (touched[brick]) {
+			result.push_back(brick);
+			touched[brick] = 0;
+		}
+	}
+
+	return result;
+}
+
+glm::ivec3 Accumulator::brickOrigin(size_t brick) const {
+	int bz = int(brick % bricks.z);
+	int by = int(brick / bricks.z % bricks.y);
+	int bx = int(brick / bricks.z / bricks.y);
+
+	return glm::ivec3(bx, by, bz) * BRICK_SIZE;
+}
+
+void Accumulator::clear() {
+	std::fill(brickSlots.begin(), brickSlots.end(), 0);
+	std::fill(touched.begin(), touched.end(), 0);
+
+	// Every slot is free again, and is zeroed when it is handed out
+	freeSlots.clear();
+	for (uint32_t slot = uint32_t(sums.size() / BRICK_VOXELS); slot >= 1; slot--) {
+		freeSlots.push_back(slot);
+	}
+}
+
+void Accumulator::clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	if (!isEnabled() || minX >= maxX || minY >= maxY || minZ >= maxZ) {
+		return;
+	}
+
+	for (int bx = minX >> BRICK_SHIFT; bx <= (maxX - 1) >> BRICK_SHIFT; bx++) {
+		for (int by = minY >> BRICK_SHIFT; by <= (maxY - 1) >> BRICK_SHIFT; by++) {
+			for (int bz = minZ >> BRICK_SHIFT; bz <= (maxZ - 1) >> BRICK_SHIFT; bz++) {
+				int x0 = bx << BRICK_SHIFT, x1 = std::min(x0 + BRICK_SIZE, dims.x);
+				int y0 = by << BRICK_SHIFT, y1 = std::min(y0 + BRICK_SIZE, dims.y);
+				int z0 = bz << BRICK_SHIFT, z1 = std::min(z0 + BRICK_SIZE, dims.z);
+				size_t brick = brickIndex(x0, y0, z0);
+				uint32_t slot = brickSlots[brick];
+
+				if (slot == 0) {
+					continue;
+				}
+
+				// A brick inside the box goes back to the pool
+				if (minX <= x0 && x1 <= maxX && minY <= y0 && y1 <= maxY && minZ <= z0 && z1 <= maxZ) {
+					brickSlots[brick] = 0;
+					freeSlots.push_back(slot);
+					continue;
+				}
+
+				for (int x = std::max(minX, x0); x < std::min(maxX, x1); x++) {
+					for (int y = std::max(minY, y0); y < std::min(maxY, y1); y++) {
+						for (int z = std::max(minZ, z0); z < std::min(maxZ, z1); z++) {
+							size_t i = size_t(slot - 1) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+							sums[i] = 0.0f;
+							weights[i] = 0.0f;
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+size_t Accumulator::memoryUsage() const {
+	return (sums.capacity() + weights.capacity()) * sizeof(float)
+		+ brickSlots.capacity() * sizeof(uint32_t) + freeSlots.capacity() * sizeof(uint32_t) + touched.capacity();
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "brickBuffer.h"
+
+// How a density map combines a new value with what a cell already holds
+enum BlendMode {
+	BLEND_DEFAULT,       // whatever each function always did (addLine() keeps the latest value, addLineSmoothed() the brightest)
+	BLEND_LATEST,        // the latest value replaces the cell
+	BLEND_MAX,           // the brightest value stays
+	BLEND_MEAN,          // the average of every value
+	BLEND_WEIGHTED_MEAN, // the average of every value, weighted (see each function for the weights)
+	BLEND_EMA            // exponential moving average, each value moves the cell a fraction alpha towards itself
+};
+
+// Returns true for the modes that need an Accumulator
+inline bool blendAccumulates(BlendMode mode) {
+	return mode == BLEND_MEAN || mode == BLEND_WEIGHTED_MEAN || mode == BLEND_EMA;
+}
+
+// Running sums behind the averaging blend modes of a density map
+// -----
+// Every cell has a sum and a weight: the mean adds the value and 1,
+// the weighted mean adds weight * value and weight, and the moving average
+// keeps the average itself in the sum and counts the values in the weight.
+// The cells of the map are only brought up to date by resolve(),
+// one brick at a time, and only for bricks that got values since the last resolve.
+// -----
+// Like SparseBuffer, the sums only get memory for the 8x8x8 bricks
+// that got a value, so memory grows with the scanned region.
+// Bricks are indexed like the storage of the map (not the window),
+// so they roll along with it.
+// -----
+// Empty until enable() is called. Copying copies the sums.
+class Accumulator {
+private:
+	BlendMode mode;
+	float alpha;
+
+	glm::ivec3 dims;
+
+	// Number of bricks along x, y, and z
+	glm::ivec3 bricks;
+
+	// Slot of every brick in sums and weights, plus one (0 means no slot yet)
+	std::vector<uint32_t> brickSlots;
+
+	// BRICK_VOXELS cells per slot, stored like BrickBuffer bricks
+	std::vector<float> sums;
+	std::vector<float> weights;
+
+	// Slots given back by clearBox(), handed out again before new ones
+	std::vector<uint32_t> freeSlots;
+
+	// One byte per brick, set when the brick gets a value
+	// Bytes instead of bits, so threads adding to different bricks never share one
+	std::vector<uint8_t> touched;
+
+	// Gives the brick a zero-filled slot and returns it (plus one)
+	uint32_t allocateBrick(size_t brick);
+
+public:
+	// Starts out disabled
+	Accumulator();
+
+	// Starts keeping sums for a map with dims cells under mode
+	// (one of the modes blendAccumulates() is true for)
+	// Every cell starts out with no values
+	void enable(glm::ivec3 dims, BlendMode mode, float alpha);
+
+	// Frees everything
+	void disable();
+
+	bool isEnabled() const { return !brickSlots.empty(); }
+
+	BlendMode getMode() const { return mode; }
+
+	// Index of the brick holding (x, y, z), counting x-major
+	size_t brickIndex(int x, int y, int z) const {
+		return (size_t(x >> BRICK_SHIFT) * bricks.y + (y >> BRICK_SHIFT)) * bricks.z + (z >> BRICK_SHIFT);
+	}
+
+	// Gives the brick holding (x, y, z) memory if it has none yet
+	// -----
+	// add() does this by itself, but handing out memory is not safe
+	// from several threads, so parallel code calls this first
+	void prepare(int x, int y, int z) {
+		size_t brick = brickIndex(x, y, z);
+
+		if (brickSlots[brick] == 0) {
+			allocateBrick(brick);
+		}
+	}
+
+	// Adds value to the cell at (x, y, z) of the storage
+	// weight only counts for BLEND_WEIGHTED_MEAN
+	// -----
+	// Threads may add to different bricks at the same time
+	// once the bricks have memory (see prepare())
+	void add(int x, int y, int z, float value, float weight) {
+		size_t brick = brickIndex(x, y, z);
+		uint32_t slot = brickSlots[brick];
+
+		if (slot == 0) {
+			slot = allocateBrick(brick);
+		}
+
+		size_t i = size_t(slot - 1) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+		float& sum = sums[i];
+		float& total = weights[i];
+
+		switch (mode) {
+		case BLEND_WEIGHTED_MEAN:
+			sum += weight * value;
+			total += weight;
+			break;
+		case BLEND_EMA:
+			sum = total == 0.0f ? value : sum + alpha * (value - sum);
+			total += 1.0f;
+			break;
+		default:
+			sum += value;
+			total += 1.0f;
+			break;
+		}
+
+		touched[brick] = 1;
+	}
+
+	// Adds a sum and a weight that were added up somewhere else
+	// (like in a PartialVolume) to the cell at (x, y, z) of the storage
+	// Only for BLEND_MEAN and BLEND_WEIGHTED_MEAN, whose sums can be split up
+	// -----
+	// Threads may add to different bricks at the same time, like add()
+	void addSum(int x, int y, int z, float sum, float weight) {
+		size_t brick = brickIndex(x, y, z);
+		uint32_t slot = brickSlots[brick];
+
+		if (slot == 0) {
+			slot = allocateBrick(brick);
+		}
+
+		size_t i = size_t(slot - 1) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+		sums[i] += sum;
+		weights[i] += weight;
+
+		touched[brick] = 1;
+	}
+
+	// Puts what the cell at (x, y, z) of the storage adds up to in value
+	// Returns false if the cell has no values
+	bool resolve(int x, int y, int z, float& value) const;
+
+	// Returns the bricks (as brickIndex() values) that got values
+	// since the last call, and forgets them
+	std::vector<size_t> takeTouchedBricks();
+
+	// Returns the first cell of a brick returned by takeTouchedBricks()
+	glm::ivec3 brickOrigin(size_t brick) const;
+
+	// Forgets every value
+	// The memory is kept for the next sweep
+	void clear();
+
+	// Forgets the values of every cell from (minX, minY, minZ) (inclusive)
+	// to (maxX, maxY, maxZ) (exclusive)
+	void clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+
+	// Number of bytes used by the sums and the tables
+	size_t memoryUsage() const;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+
+// Views a plain value as a std::atomic, for data that is usually
+// only touched by one thread but sometimes by several at once
+// -----
+// std::atomic<T> has to be exactly a T for this to work (no lock stored next to it),
+// which holds for the lock-free types used here and is checked when it is compiled.
+// Every thread touching the value at the same time has to go through this.
+template<typename T>
+std::atomic<T>& asAtomic(T& value) {
+	static_assert(sizeof(std::atomic<T>) == sizeof(T), "std::atomic<T> must be the same size as T");
+	static_assert(alignof(std::atomic<T>) == alignof(T), "std::atomic<T> must be aligned like T");
+
+	return *reinterpret_cast<std::atomic<T>*>(&value);
+}
+
+// Lowers value to candidate, unless it is already lower
+// Safe while other threads do the same
+template<typename T>
+void atomicMin(T& value, T candidate) {
+	std::atomic<T>& target = asAtomic(value);
+	T current = target.load(std::memory_order_relaxed);
+
+	// A failed exchange reloads current, so this stops as soon as
+	// the value is low enough, whoever lowered it
+	while (candidate < current && !target.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+	}
+}
+
+// Raises value to candidate, unless it is already higher
+// Safe while other threads do the same
+template<typename T>
+void atomicMax(T& value, T candidate) {
+	std::atomic<T>& target = asAtomic(value);
+	T current = target.load(std::memory_order_relaxed);
+
+	while (current < candidate && !target.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+	}
+}
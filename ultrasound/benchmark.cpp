@@ -0,0 +1,351 @@
+#include "benchmark.h"
+#include "densityMap.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Returns the number of seconds since start
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Stamps a bundle of smoothed lines through the middle of the grid
+template<typename Map>
+static double timeSphereStamp(Map& grid) {
+	std::vector<float> vals(200, 1.0f);
+	glm::vec3 extent = grid.getExtent();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < 100; i++) {
+		glm::vec3 offset = glm::vec3(0.0f, 0.0f, i * 0.002f) * extent;
+		grid.addLineSmoothed(glm::vec3(0.1f, 0.1f, 0.2f) * extent + offset, glm::vec3(0.9f, 0.8f, 0.2f) * extent + offset, vals, 5);
+	}
+
+	return secondsSince(start);
+}
+
+// Sums the 6 face neighbours of every cell, like a small blur would
+template<typename Map>
+static double timeNeighbourhood(const Map& grid, float& checksum) {
+	glm::ivec3 dims = grid.getDims();
+
+	auto start = std::chrono::steady_clock::now();
+
+	float sum = 0.0f;
+	for (int x = 1; x < dims.x - 1; x++) {
+		for (int y = 1; y < dims.y - 1; y++) {
+			for (int z = 1; z < dims.z - 1; z++) {
+				sum += grid.get(x - 1, y, z) + grid.get(x + 1, y, z)
+					+ grid.get(x, y - 1, z) + grid.get(x, y + 1, z)
+					+ grid.get(x, y, z - 1) + grid.get(x, y, z + 1);
+			}
+		}
+	}
+
+	// Stops the compiler from throwing the loop away
+	checksum = sum;
+
+	return secondsSince(start);
+}
+
+void layoutBenchmark(int dim) {
+	std::cout << "Layout benchmark, dim = " << dim << std::endl;
+
+	DensityMap linear(dim);
+	BrickedDensityMap bricked(dim);
+
+	float linearSum, brickedSum;
+
+	std::cout << "  sphere stamp   linear " << timeSphereStamp(linear) << " s"
+		<< ", bricked " << timeSphereStamp(bricked) << " s" << std::endl;
+
+	std::cout << "  neighbourhood  linear " << timeNeighbourhood(linear, linearSum) << " s"
+		<< ", bricked " << timeNeighbourhood(bricked, brickedSum) << " s" << std::endl;
+
+	if (linearSum != brickedSum) {
+		std::cout << "  the two layouts disagree!" << std::endl;
+	}
+}
+
+// Pose of frame i of the sweep: the probe at the top of the grid looking down (+z),
+// moving one cell along y every frame, with the fan spread across x
+static glm::mat4 sweepPose(glm::vec3 extent, int dim, int i) {
+	glm::mat4 pose(1.0f);
+	pose[3] = glm::vec4(0.5f * extent.x, (0.25f + float(i) / dim) * extent.y, 0.05f * extent.z, 1.0f);
+	return pose;
+}
+
+// Adds every frame of the sweep to grid, and returns the seconds it took
+// mode is RECONSTRUCT_FORWARD or RECONSTRUCT_BACKWARD, or -1 for addLine() on every line
+static double timeSweep(DensityMap& grid, const FrameGeometry& geometry, const std::vector<float>& samples, int frames, int mode) {
+	glm::vec3 extent = grid.getExtent();
+	int dim = grid.getDim();
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int i = 0; i < frames; i++) {
+		glm::mat4 pose = sweepPose(extent, dim, i);
+
+		if (mode >= 0) {
+			grid.addFrame(pose, geometry, samples, ReconstructionMode(mode));
+			continue;
+		}
+
+		// The same lines, one at a time, the way fanDemo() adds them
+		glm::vec3 apex(pose[3]);
+
+		for (int line = 0; line < geometry.lines; line++) {
+			float angle = (float(line) / (geometry.lines - 1) - 0.5f) * geometry.sectorAngle;
+			glm::vec3 end = apex + geometry.depth * glm::vec3(std::sin(angle), 0.0f, std::cos(angle));
+
+			grid.addLine(apex, end, SampleView(samples).slice(size_t(line) * geometry.samplesPerLine, geometry.samplesPerLine));
+		}
+	}
+
+	return secondsSince(start);
+}
+
+void reconstructionBenchmark(int dim) {
+	std::cout << "Reconstruction benchmark, dim = " << dim << std::endl;
+
+	// A coarse fan (lines far apart at depth) with fine samples along each line,
+	// and every sample 1 so any cell left at zero is a hole
+	FrameGeometry geometry;
+	geometry.sectorAngle = 1.2f;
+	geometry.depth = 0.85f;
+	geometry.lines = 64;
+	geometry.samplesPerLine = 512;
+
+	std::vector<float> samples(size_t(geometry.lines) * geometry.samplesPerLine, 1.0f);
+	int frames = dim / 2;
+
+	DensityMap lines(dim), forward(dim), backward(dim);
+
+	double linesTime = timeSweep(lines, geometry, samples, frames, -1);
+	double forwardTime = timeSweep(forward, geometry, samples, frames, RECONSTRUCT_FORWARD);
+	double backwardTime = timeSweep(backward, geometry, samples, frames, RECONSTRUCT_BACKWARD);
+
+	// Backward reconstruction writes every cell inside the swept fan,
+	// so the cells it wrote are the ones the others should have too
+	size_t covered = 0, linesHoles = 0, forwardHoles = 0;
+
+	for (int x = 0; x < dim; x++) {
+		for (int y = 0; y < dim; y++) {
+			for (int z = 0; z < dim; z++) {
+				if (backward.get(x, y, z) == 0.0f) {
+					continue;
+				}
+
+				covered++;
+				linesHoles += lines.get(x, y, z) == 0.0f;
+				forwardHoles += forward.get(x, y, z) == 0.0f;
+			}
+		}
+	}
+
+	std::cout << "  " << frames << " frames of " << geometry.lines << " x " << geometry.samplesPerLine
+		<< " samples, " << covered << " cells swept" << std::endl;
+	std::cout << "  addLine   " << linesTime << " s, " << linesHoles << " holes" << std::endl;
+	std::cout << "  forward   " << forwardTime << " s, " << forwardHoles << " holes" << std::endl;
+	std::cout << "  backward  " << backwardTime << " s, 0 holes" << std::endl;
+}
+
+// Has threads producers add linesPerThread lines each to grid at the same time,
+// and returns the seconds it took
+// Every line goes through the middle of the grid, so the threads fight over the same cells
+template<typename Map>
+static double timeProducers(Map& grid, int threads, int linesPerThread, bool smoothed, bool locked) {
+	glm::vec3 extent = grid.getExtent();
+	std::mutex lock;
+	std::vector<std::thread> producers;
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int t = 0; t < threads; t++) {
+		producers.push_back(std::thread([&, t]() {
+			std::vector<float> vals(256, 1.0f);
+
+			for (int i = 0; i < linesPerThread; i++) {
+				// Spins every line around the middle, a little differently on every thread
+				float angle = 0.01f * (i * threads + t);
+				glm::vec3 direction(std::cos(angle), std::sin(angle), std::sin(0.37f * angle));
+				glm::vec3 p1 = (0.5f - 0.4f * direction) * extent;
+				glm::vec3 p2 = (0.5f + 0.4f * direction) * extent;
+
+				if (locked) {
+					std::lock_guard<std::mutex> guard(lock);
+
+					if (smoothed) {
+						grid.addLineSmoothed(p1, p2, vals, 2);
+					}
+					else {
+						grid.addLine(p1, p2, vals);
+					}
+				}
+				else if (smoothed) {
+					grid.addLineSmoothedConcurrent(p1, p2, vals, 2);
+				}
+				else {
+					grid.addLineConcurrent(p1, p2, vals);
+				}
+			}
+		}));
+	}
+
+	for (size_t t = 0; t < producers.size(); t++) {
+		producers[t].join();
+	}
+
+	return secondsSince(start);
+}
+
+void concurrencyBenchmark(int dim, int maxThreads) {
+	std::cout << "Concurrency benchmark, dim = " << dim << std::endl;
+
+	// The same number of lines in total for every thread count
+	const int totalLines = 4096;
+
+	for (int threads = 1; threads <= maxThreads; threads *= 2) {
+		DensityMap grid(dim);
+		int linesPerThread = totalLines / threads;
+
+		double concurrent = timeProducers(grid, threads, linesPerThread, false, false);
+		double locked = timeProducers(grid, threads, linesPerThread, false, true);
+		double smoothedConcurrent = timeProducers(grid, threads, linesPerThread / 8, true, false);
+		double smoothedLocked = timeProducers(grid, threads, linesPerThread / 8, true, true);
+
+		std::cout << "  " << threads << " threads  addLine: atomic " << concurrent << " s, mutex " << locked << " s"
+			<< "  addLineSmoothed: atomic " << smoothedConcurrent << " s, mutex " << smoothedLocked << " s" << std::endl;
+	}
+}
+
+// One frame of lines fanning out from an apex near the top of the grid,
+// turned a little further every frame, every line looking at samples
+static std::vector<ScanLine> apexFrame(glm::vec3 extent, int frame, const std::vector<float>& samples) {
+	std::vector<ScanLine> lines(256);
+	glm::vec3 apex = glm::vec3(0.5f, 0.5f, 0.1f) * extent;
+
+	for (int i = 0; i < int(lines.size()); i++) {
+		float angle = 0.02f * i + 0.1f * frame;
+
+		lines[i].p1 = apex;
+		lines[i].p2 = apex + glm::vec3(0.4f * std::cos(angle), 0.4f * std::sin(angle), 0.8f) * extent;
+		lines[i].vals = samples;
+	}
+
+	return lines;
+}
+
+// Adds frames frames from apexFrame() to grid in one of three ways, and returns the seconds it took
+// way 0 is addLines(), 1 is addLineConcurrent() on every thread of the pool, and 2 is addLinesCompounded()
+template<typename Map>
+static double timeCompounding(Map& grid, int frames, int way) {
+	ThreadPool& pool = ThreadPool::shared();
+	glm::vec3 extent = grid.getExtent();
+
+	std::vector<float> samples(512, 1.0f);
+	std::vector<std::vector<ScanLine>> sweep;
+	for (int frame = 0; frame < frames; frame++) {
+		sweep.push_back(apexFrame(extent, frame, samples));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (int frame = 0; frame < frames; frame++) {
+		const std::vector<ScanLine>& lines = sweep[frame];
+
+		if (way == 0) {
+			grid.addLines(lines, pool);
+		}
+		else if (way == 1) {
+			pool.parallelFor(int(lines.size()), [&](int i, int /*thread*/) {
+				grid.addLineConcurrent(lines[i].p1, lines[i].p2, lines[i].vals);
+			});
+		}
+		else {
+			grid.addLinesCompounded(lines, pool);
+		}
+	}
+
+	return secondsSince(start);
+}
+
+void compoundingBenchmark(int dim) {
+	std::cout << "Compounding benchmark, dim = " << dim << ", threads = " << ThreadPool::shared().getThreadCount() << std::endl;
+
+	const int frames = 20;
+	double seconds[3];
+
+	for (int way = 0; way < 3; way++) {
+		DensityMap grid(dim);
+		grid.setBlendMode(BLEND_MAX);
+		seconds[way] = timeCompounding(grid, frames, way);
+	}
+
+	std::cout << "  addLines " << seconds[0] << " s, addLineConcurrent " << seconds[1] << " s"
+		<< ", addLinesCompounded " << seconds[2] << " s" << std::endl;
+}
+
+void ingestBenchmark(int dim) {
+	std::cout << "Ingest benchmark, dim = " << dim << std::endl;
+
+	const int lineCount = 4096;
+	const int samplesPerLine = 1024;
+
+	// Made-up envelope samples, and a table that log-compresses them
+	std::vector<uint8_t> raw(size_t(lineCount) * samplesPerLine);
+	for (size_t i = 0; i < raw.size(); i++) {
+		raw[i] = uint8_t(i * 2654435761u >> 24);
+	}
+
+	std::vector<float> lut(256);
+	for (int i = 0; i < 256; i++) {
+		lut[i] = std::log(1.0f + i) / std::log(256.0f);
+	}
+
+	double seconds[2];
+
+	for (int way = 0; way < 2; way++) {
+		DensityMap grid(dim);
+		glm::vec3 extent = grid.getExtent();
+
+		auto start = std::chrono::steady_clock::now();
+
+		for (int line = 0; line < lineCount; line++) {
+			float angle = 0.01f * line;
+			glm::vec3 p1 = glm::vec3(0.5f, 0.5f, 0.1f) * extent;
+			glm::vec3 p2 = p1 + glm::vec3(0.4f * std::cos(angle), 0.4f * std::sin(angle), 0.8f) * extent;
+			const uint8_t* samples = raw.data() + size_t(line) * samplesPerLine;
+
+			if (way == 0) {
+				std::vector<float> vals(samplesPerLine);
+
+				for (int i = 0; i < samplesPerLine; i++) {
+					vals[i] = lut[samples[i]];
+				}
+
+				grid.addLine(p1, p2, vals);
+			}
+			else {
+				grid.addLine(p1, p2, SampleView(Span<const uint8_t>(samples, samplesPerLine), Span<const float>(lut.data(), lut.size())));
+			}
+		}
+
+		seconds[way] = secondsSince(start);
+	}
+
+	std::cout << "  converted " << seconds[0] << " s, view " << seconds[1] << " s" << std::endl;
+}
+
+void runBenchmarks() {
+	layoutBenchmark();
+	reconstructionBenchmark();
+	concurrencyBenchmark();
+	compoundingBenchmark();
+	ingestBenchmark();
+}
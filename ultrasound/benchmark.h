@@ -0,0 +1,33 @@
+#pragma once
+
+// Timing runs used to compare the different ways of storing
+// and filling a density map
+// -----
+// These print their results to the console.
+// Run the application with --benchmark to run them instead of the viewer.
+
+// Runs every benchmark below with its default size
+void runBenchmarks();
+
+// Compares VoxelBuffer and BrickBuffer on the sphere stamp
+// in addLineSmoothed() and on a neighbourhood filter
+void layoutBenchmark(int dim = 256);
+
+// Compares the ways of adding a sweep of fan-shaped frames:
+// addLine() for every line, and addFrame() forwards and backwards,
+// by time and by the holes each leaves inside the swept fan
+void reconstructionBenchmark(int dim = 256);
+
+// Adds lines from several producer threads at once, all crossing the middle
+// of the grid, with addLineConcurrent() and addLineSmoothedConcurrent()
+// and with addLine() and addLineSmoothed() behind one mutex, for 1 to maxThreads threads
+void concurrencyBenchmark(int dim = 256, int maxThreads = 8);
+
+// Adds frames of lines that all start at the same apex, like fanDemo() in main.cpp,
+// under BLEND_MAX with addLines(), with addLineConcurrent() from every thread,
+// and with addLinesCompounded()
+void compoundingBenchmark(int dim = 256);
+
+// Adds lines of 8-bit samples through a lookup table, once by converting every line
+// to a std::vector<float> first and once by passing the samples straight to addLine()
+void ingestBenchmark(int dim = 256);
@@ -0,0 +1,232 @@
+#include "brickBuffer.h"
+#include "voxelTypes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// Spreads the lowest 21 bits of v out so there are
+// two zero bits between each of them
+static uint64_t spreadBits(uint64_t v) {
+	v &= 0x1fffff;
+	v = (v | (v << 32)) & 0x1f00000000ffffull;
+	v = (v | (v << 16)) & 0x1f0000ff0000ffull;
+	v = (v | (v << 8)) & 0x100f00f00f00f00full;
+	v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+	v = (v | (v << 2)) & 0x1249249249249249ull;
+	return v;
+}
+
+// Position of (x, y, z) along the Z-order curve
+static uint64_t mortonCode(int x, int y, int z) {
+	return (spreadBits(x) << 2) | (spreadBits(y) << 1) | spreadBits(z);
+}
+
+template<typename T>
+BrickBuffer<T>::BrickBuffer(int dimX, int dimY, int dimZ) {
+	this->dimX = dimX;
+	this->dimY = dimY;
+	this->dimZ = dimZ;
+
+	bricksX = (dimX + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksY = (dimY + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksZ = (dimZ + BRICK_SIZE - 1) / BRICK_SIZE;
+
+	// Sorts the bricks by their Morton codes
+	// -----
+	// Indexing memory with the Morton code directly would waste space
+	// whenever the brick counts are not equal powers of two,
+	// so each brick gets its rank along the curve instead
+	std::vector<std::pair<uint64_t, uint32_t>> order;
+	order.reserve(size_t(bricksX) * bricksY * bricksZ);
+
+	for (int bx = 0; bx < bricksX; bx++) {
+		for (int by = 0; by < bricksY; by++) {
+			for (int bz = 0; bz < bricksZ; bz++) {
+				uint32_t index = uint32_t(brickIndex(bx << BRICK_SHIFT, by << BRICK_SHIFT, bz << BRICK_SHIFT));
+				order.push_back(std::make_pair(mortonCode(bx, by, bz), index));
+			}
+		}
+	}
+
+	std::sort(order.begin(), order.end());
+
+	brickSlots.resize(order.size());
+	for (size_t slot = 0; slot < order.size(); slot++) {
+		brickSlots[order[slot].second] = uint32_t(slot);
+	}
+
+	// Every brick starts out stale, so the memory
+	// does not have to be zeroed up front
+	brickGenerations.assign(brickSlots.size(), 0);
+	generation = 1;
+
+	allocate();
+}
+
+template<typename T>
+BrickBuffer<T>::~BrickBuffer() {
+	release();
+}
+
+template<typename T>
+BrickBuffer<T>::BrickBuffer(const BrickBuffer<T>& other) : brickSlots(other.brickSlots), brickGenerations(other.brickGenerations) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	bricksX = other.bricksX;
+	bricksY = other.bricksY;
+	bricksZ = other.bricksZ;
+	generation = other.generation;
+
+	allocate();
+	memcpy(voxels, other.voxels, size() * sizeof(T));
+}
+
+template<typename T>
+BrickBuffer<T>::BrickBuffer(BrickBuffer<T>&& other) : brickSlots(std::move(other.brickSlots)), brickGenerations(std::move(other.brickGenerations)) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	bricksX = other.bricksX;
+	bricksY = other.bricksY;
+	bricksZ = other.bricksZ;
+	generation = other.generation;
+	voxels = other.voxels;
+
+	other.voxels = nullptr;
+}
+
+template<typename T>
+BrickBuffer<T>& BrickBuffer<T>::operator=(const BrickBuffer<T>& other) {
+	if (this != &other) {
+		BrickBuffer<T> copy(other);
+		*this = std::move(copy);
+	}
+
+	return *this;
+}
+
+template<typename T>
+BrickBuffer<T>& BrickBuffer<T>::operator=(BrickBuffer<T>&& other) {
+	if (this != &other) {
+		release();
+
+		dimX = other.dimX;
+		dimY = other.dimY;
+		dimZ = other.dimZ;
+		bricksX = other.bricksX;
+		bricksY = other.bricksY;
+		bricksZ = other.bricksZ;
+		brickSlots = std::move(other.brickSlots);
+		brickGenerations = std::move(other.brickGenerations);
+		generation = other.generation;
+		voxels = other.voxels;
+
+		other.voxels = nullptr;
+	}
+
+	return *this;
+}
+
+template<typename T>
+void BrickBuffer<T>::allocate() {
+	voxels = static_cast<T*>(alignedAlloc(size() * sizeof(T)));
+}
+
+template<typename T>
+void BrickBuffer<T>::release() {
+	alignedFree(voxels);
+	voxels = nullptr;
+}
+
+template<typename T>
+const T BrickBuffer<T>::zeroCell = T();
+
+template<typename T>
+void BrickBuffer<T>::resetBrick(size_t slot) const {
+	// All-zero bytes are zero in every voxel type
+	memset(voxels + slot * BRICK_VOXELS, 0, BRICK_VOXELS * sizeof(T));
+	brickGenerations[slot] = generation;
+}
+
+template<typename T>
+const T* BrickBuffer<T>::readRow(int x, int y, T* scratch) const {
+	for (int z = 0; z < dimZ; z += BRICK_SIZE) {
+		int count = std::min(BRICK_SIZE, dimZ - z);
+		size_t slot = brickSlots[brickIndex(x, y, z)];
+
+		if (brickGenerations[slot] == generation) {
+			memcpy(scratch + z, voxels + slot * BRICK_VOXELS + brickLocalIndex(x, y, 0), count * sizeof(T));
+		}
+		else {
+			memset(scratch + z, 0, count * sizeof(T));
+		}
+	}
+
+	return scratch;
+}
+
+template<typename T>
+void BrickBuffer<T>::zeroStaleBricks() const {
+	for (size_t slot = 0; slot < brickGenerations.size(); slot++) {
+		if (brickGenerations[slot] != generation) {
+			resetBrick(slot);
+		}
+	}
+}
+
+template<typename T>
+void BrickBuffer<T>::clear() {
+	generation++;
+
+	// After 2^32 clears the counter wraps around, and an old stamp could
+	// look current again, so every brick is marked stale by hand
+	if (generation == 0) {
+		std::fill(brickGenerations.begin(), brickGenerations.end(), 0);
+		generation = 1;
+	}
+}
+
+template<typename T>
+void BrickBuffer<T>::clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+		return;
+	}
+
+	for (int bx = minX >> BRICK_SHIFT; bx <= (maxX - 1) >> BRICK_SHIFT; bx++) {
+		for (int by = minY >> BRICK_SHIFT; by <= (maxY - 1) >> BRICK_SHIFT; by++) {
+			for (int bz = minZ >> BRICK_SHIFT; bz <= (maxZ - 1) >> BRICK_SHIFT; bz++) {
+				int x0 = bx << BRICK_SHIFT, x1 = std::min(x0 + BRICK_SIZE, dimX);
+				int y0 = by << BRICK_SHIFT, y1 = std::min(y0 + BRICK_SIZE, dimY);
+				int z0 = bz << BRICK_SHIFT, z1 = std::min(z0 + BRICK_SIZE, dimZ);
+				size_t slot = brickSlots[brickIndex(x0, y0, z0)];
+
+				// Stale bricks already read as zero
+				if (brickGenerations[slot] != generation) {
+					continue;
+				}
+
+				// A brick inside the box is dropped instead of wiped
+				// (generation is never 0, so this is always an older generation)
+				if (minX <= x0 && x1 <= maxX && minY <= y0 && y1 <= maxY && minZ <= z0 && z1 <= maxZ) {
+					brickGenerations[slot] = generation - 1;
+					continue;
+				}
+
+				int fromZ = std::max(minZ, z0), toZ = std::min(maxZ, z1);
+
+				for (int x = std::max(minX, x0); x < std::min(maxX, x1); x++) {
+					for (int y = std::max(minY, y0); y < std::min(maxY, y1); y++) {
+						memset(voxels + slot * BRICK_VOXELS + brickLocalIndex(x, y, fromZ), 0, (toZ - fromZ) * sizeof(T));
+					}
+				}
+			}
+		}
+	}
+}
+
+template class BrickBuffer<float>;
+template class BrickBuffer<uint8_t>;
+template class BrickBuffer<uint16_t>;
+template class BrickBuffer<Half>;
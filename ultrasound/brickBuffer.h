@@ -0,0 +1,157 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "voxelBuffer.h"
+
+// Number of cells along each side of a brick, and its log2
+#define BRICK_SIZE 8
+#define BRICK_SHIFT 3
+
+// Number of cells in one brick
+#define BRICK_VOXELS (BRICK_SIZE * BRICK_SIZE * BRICK_SIZE)
+
+// Position of (x, y, z) inside its brick
+// Cells inside a brick are stored z fastest, like VoxelBuffer
+inline size_t brickLocalIndex(int x, int y, int z) {
+	const int mask = BRICK_SIZE - 1;
+	return ((x & mask) << (2 * BRICK_SHIFT)) | ((y & mask) << BRICK_SHIFT) | (z & mask);
+}
+
+// 3D array of voxels of type T stored as 8x8x8 bricks
+// -----
+// Each brick is one contiguous block of BRICK_VOXELS cells
+// (stored z fastest, like VoxelBuffer), so all the neighbours of a cell
+// are at most a few cache lines away instead of a few rows or planes away.
+// The bricks themselves are laid out along a Z-order (Morton) curve,
+// so bricks that are close in space are also close in memory.
+// Sides that are not a multiple of 8 are padded with zero cells.
+// -----
+// Clearing is lazy: every brick carries the generation it was last written in,
+// and clear() only starts a new generation.
+// A brick from an older generation reads as zero,
+// and is filled with zeroes the first time it is written again,
+// so only the bricks that are actually reused are ever wiped.
+// -----
+// Has the same accessor interface as VoxelBuffer (see BasicDensityMap)
+// Instantiated in brickBuffer.cpp for every type in voxelTypes.h
+template<typename T>
+class BrickBuffer {
+private:
+	int dimX;
+	int dimY;
+	int dimZ;
+
+	// Number of bricks along x, y, and z
+	int bricksX;
+	int bricksY;
+	int bricksZ;
+
+	// Position of every brick along the Z-order curve,
+	// indexed by brickIndex()
+	std::vector<uint32_t> brickSlots;
+
+	// Aligned block holding every brick
+	T* voxels;
+
+	// Generation every brick was last written in, indexed by slot
+	// Zeroing stale bricks does not change what the buffer holds,
+	// so this is mutable for span() const
+	mutable std::vector<uint32_t> brickGenerations;
+
+	// The current generation, bumped by clear()
+	uint32_t generation;
+
+	// What stale bricks read as
+	static const T zeroCell;
+
+	// Fills the brick in slot with zeroes and marks it current
+	void resetBrick(size_t slot) const;
+
+	void allocate();
+	void release();
+
+public:
+	BrickBuffer(int dimX, int dimY, int dimZ);
+	~BrickBuffer();
+
+	BrickBuffer(const BrickBuffer& other);
+	BrickBuffer(BrickBuffer&& other);
+	BrickBuffer& operator=(const BrickBuffer& other);
+	BrickBuffer& operator=(BrickBuffer&& other);
+
+	// Index of the brick holding (x, y, z), counting x-major
+	// (this is not the position of the brick in memory)
+	size_t brickIndex(int x, int y, int z) const {
+		return (size_t(x >> BRICK_SHIFT) * bricksY + (y >> BRICK_SHIFT)) * bricksZ + (z >> BRICK_SHIFT);
+	}
+
+	// Position of (x, y, z) in data()
+	size_t index(int x, int y, int z) const {
+		return size_t(brickSlots[brickIndex(x, y, z)]) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+	}
+
+	// Access to one cell for writing, without bounds checks
+	// Wipes the brick holding the cell first if it is stale
+	T& operator()(int x, int y, int z) {
+		size_t slot = brickSlots[brickIndex(x, y, z)];
+
+		if (brickGenerations[slot] != generation) {
+			resetBrick(slot);
+		}
+
+		return voxels[slot * BRICK_VOXELS + brickLocalIndex(x, y, z)];
+	}
+
+	// Access to one cell for reading, without bounds checks
+	// Cells in stale bricks are zero
+	const T& operator()(int x, int y, int z) const {
+		size_t slot = brickSlots[brickIndex(x, y, z)];
+
+		if (brickGenerations[slot] != generation) {
+			return zeroCell;
+		}
+
+		return voxels[slot * BRICK_VOXELS + brickLocalIndex(x, y, z)];
+	}
+
+	// Copies the row at (x, y) into scratch and returns scratch
+	// -----
+	// scratch must hold at least dimZ cells.
+	// Each brick holds 8 cells of the row next to each other,
+	// so this is one small copy per brick.
+	const T* readRow(int x, int y, T* scratch) const;
+
+	// Raw access to the whole block, padding included
+	// -----
+	// Stale bricks still hold their old cells here,
+	// so call zeroStaleBricks() first (span() does it for you)
+	T* data() { return voxels; }
+	const T* data() const { return voxels; }
+
+	// Number of voxels in data(), padding included
+	size_t size() const { return size_t(bricksX) * bricksY * bricksZ * BRICK_VOXELS; }
+
+	// The whole block as a span, padding included
+	// Stale bricks are wiped first, so every cell reads correctly
+	Span<T> span() { zeroStaleBricks(); return Span<T>(voxels, size()); }
+	Span<const T> span() const { zeroStaleBricks(); return Span<const T>(voxels, size()); }
+
+	// Fills every stale brick with zeroes
+	// After this, data() matches what the accessors return
+	void zeroStaleBricks() const;
+
+	// Number of bytes used by the cells
+	size_t memoryUsage() const { return size() * sizeof(T); }
+
+	// Overwrites every cell with zero
+	// Takes constant time, see the top of the class
+	void clear();
+
+	// Overwrites every cell from (minX, minY, minZ) (inclusive)
+	// to (maxX, maxY, maxZ) (exclusive) with zero
+	// Bricks inside the box are only marked stale, like clear() does
+	void clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+};
@@ -0,0 +1,256 @@
+#include "checks.h"
+#include "densityMap.h"
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Prints whether what was checked passed and returns failures
+static int report(const char* what, int failures) {
+	if (failures == 0) {
+		std::cout << "  " << what << ": ok" << std::endl;
+	}
+	else {
+		std::cout << "  " << what << ": " << failures << " failures" << std::endl;
+	}
+
+	return failures;
+}
+
+// Returns the number of cells that differ between a and b (which have the same dims)
+template<typename A, typename B>
+static int countDifferences(const A& a, const B& b) {
+	glm::ivec3 dims = a.getDims();
+	int differences = 0;
+
+	for (int x = 0; x < dims.x; x++) {
+		for (int y = 0; y < dims.y; y++) {
+			for (int z = 0; z < dims.z; z++) {
+				differences += a.get(x, y, z) != b.get(x, y, z);
+			}
+		}
+	}
+
+	return differences;
+}
+
+// Returns count lines between random points around the window of grid,
+// reaching up to a fifth of the window past it on every side, with random values
+// The values are kept in samples (one vector per line), which the lines point at
+template<typename Map>
+static std::vector<ScanLine> randomLines(const Map& grid, int count, unsigned seed, std::vector<std::vector<float>>& samples) {
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> uniform(-0.2f, 1.2f);
+	std::uniform_real_distribution<float> density(0.0f, 1.0f);
+
+	glm::vec3 min = grid.getWindowMin();
+	glm::vec3 extent = grid.getExtent();
+	std::vector<ScanLine> lines(count);
+	samples.resize(count);
+
+	for (int i = 0; i < count; i++) {
+		lines[i].p1 = min + glm::vec3(uniform(random), uniform(random), uniform(random)) * extent;
+		lines[i].p2 = min + glm::vec3(uniform(random), uniform(random), uniform(random)) * extent;
+		samples[i].resize(1 + random() % 100);
+
+		for (size_t k = 0; k < samples[i].size(); k++) {
+			samples[i][k] = density(random);
+		}
+
+		lines[i].vals = samples[i];
+	}
+
+	return lines;
+}
+
+// Returns the number of cells of FixedStencil<R> that are not exactly the same
+// as the cell of SmoothingStencil(R) in the same place (both go row by row along z)
+template<int R>
+static int compareStencil() {
+	const FixedStencilTable<R>& table = FixedStencil<R>::table;
+	SmoothingStencil stencil(R);
+	const StencilEntry* entries = stencil.getEntries();
+
+	int failures = stencil.size() == size_t(table.cellCount) ? 0 : 1;
+	size_t i = 0;
+
+	for (int row = 0; row < table.rowCount; row++) {
+		for (int dz = -table.half[row]; dz <= table.half[row] && i < stencil.size(); dz++, i++) {
+			const StencilEntry& entry = entries[i];
+			float weight = table.weight[table.start[row] + dz + table.half[row]];
+
+			if (entry.dx != table.dx[row] || entry.dy != table.dy[row] || entry.dz != dz || entry.weight != weight) {
+				failures++;
+			}
+		}
+	}
+
+	return failures;
+}
+
+int stencilCheck() {
+	std::cout << "Stencil check" << std::endl;
+
+	int failures = compareStencil<1>() + compareStencil<2>() + compareStencil<3>() + compareStencil<4>()
+		+ compareStencil<5>() + compareStencil<6>() + compareStencil<7>() + compareStencil<8>();
+
+	int total = report("FixedStencil<R> against SmoothingStencil(R)", failures);
+
+	// Lines of every radius from 1 to 8, some of them running off the grid
+	DensityMap linear(64);
+	BrickedDensityMap bricked(64);
+	std::vector<float> vals(40);
+
+	for (size_t i = 0; i < vals.size(); i++) {
+		vals[i] = 0.2f + 0.02f * i;
+	}
+
+	for (int radius = 1; radius <= 8; radius++) {
+		glm::vec3 p1 = glm::vec3(0.1f, 0.05f * radius, 0.3f);
+		glm::vec3 p2 = glm::vec3(0.9f, 1.0f - 0.1f * radius, 1.1f);
+
+		linear.addLineSmoothed(p1, p2, vals, radius);
+		bricked.addLineSmoothed(p1, p2, vals, radius);
+	}
+
+	total += report("addLineSmoothed() with radius 1 to 8, VoxelBuffer against BrickBuffer", countDifferences(linear, bricked));
+
+	return total;
+}
+
+// Adds the same lines to batched with addLines() on pool
+// and to sequential with addLine(), and returns the number of cells that differ
+template<typename Map>
+static int compareAddLines(Map& batched, Map& sequential, ThreadPool& pool) {
+	batched.setOrigin(glm::ivec3(3, -2, 5));
+	sequential.setOrigin(glm::ivec3(3, -2, 5));
+
+	std::vector<std::vector<float>> samples;
+	std::vector<ScanLine> lines = randomLines(batched, 300, 1, samples);
+
+	batched.addLines(lines, pool);
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		sequential.addLine(lines[i].p1, lines[i].p2, lines[i].vals);
+	}
+
+	return countDifferences(batched, sequential);
+}
+
+int addLinesCheck() {
+	std::cout << "addLines() check" << std::endl;
+
+	ThreadPool pool(4);
+	glm::ivec3 dims(50, 40, 60);
+	glm::vec3 spacing(1.0f);
+	int total = 0;
+
+	DensityMap linear(dims, spacing), linearSequential(dims, spacing);
+	total += report("VoxelBuffer", compareAddLines(linear, linearSequential, pool));
+
+	DensityMap8 small(dims, spacing), smallSequential(dims, spacing);
+	total += report("VoxelBuffer, 8-bit", compareAddLines(small, smallSequential, pool));
+
+	BrickedDensityMap bricked(dims, spacing), brickedSequential(dims, spacing);
+	total += report("BrickBuffer", compareAddLines(bricked, brickedSequential, pool));
+
+	SparseDensityMap sparse(dims, spacing), sparseSequential(dims, spacing);
+	total += report("SparseBuffer", compareAddLines(sparse, sparseSequential, pool));
+
+	return total;
+}
+
+// Adds the same lines to concurrent with addLineConcurrent() (or addLineSmoothedConcurrent())
+// from every thread of pool and to sequential with addLine() (or addLineSmoothed()),
+// both under BLEND_MAX, and returns the number of cells that differ
+template<typename Map>
+static int compareConcurrent(Map& concurrent, Map& sequential, ThreadPool& pool, bool smoothed) {
+	concurrent.setBlendMode(BLEND_MAX);
+	sequential.setBlendMode(BLEND_MAX);
+
+	std::vector<std::vector<float>> samples;
+	std::vector<ScanLine> lines = randomLines(concurrent, 200, 2, samples);
+
+	pool.parallelFor(int(lines.size()), [&](int i, int /*thread*/) {
+		if (smoothed) {
+			concurrent.addLineSmoothedConcurrent(lines[i].p1, lines[i].p2, lines[i].vals, 3);
+		}
+		else {
+			concurrent.addLineConcurrent(lines[i].p1, lines[i].p2, lines[i].vals);
+		}
+	});
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		if (smoothed) {
+			sequential.addLineSmoothed(lines[i].p1, lines[i].p2, lines[i].vals, 3);
+		}
+		else {
+			sequential.addLine(lines[i].p1, lines[i].p2, lines[i].vals);
+		}
+	}
+
+	return countDifferences(concurrent, sequential);
+}
+
+int concurrentCheck() {
+	std::cout << "Concurrent insertion check" << std::endl;
+
+	ThreadPool pool(4);
+	glm::ivec3 dims(50, 40, 60);
+	glm::vec3 spacing(1.0f);
+	int total = 0;
+
+	DensityMap lines(dims, spacing), linesSequential(dims, spacing);
+	total += report("addLineConcurrent()", compareConcurrent(lines, linesSequential, pool, false));
+
+	DensityMap smoothed(dims, spacing), smoothedSequential(dims, spacing);
+	total += report("addLineSmoothedConcurrent()", compareConcurrent(smoothed, smoothedSequential, pool, true));
+
+	return total;
+}
+
+// Adds the same lines to compounded with addLinesCompounded() on pool
+// and to sequential with addLine(), both under BLEND_MAX,
+// and returns the number of cells that differ
+template<typename Map>
+static int compareCompounded(Map& compounded, Map& sequential, ThreadPool& pool) {
+	compounded.setOrigin(glm::ivec3(-4, 6, 1));
+	sequential.setOrigin(glm::ivec3(-4, 6, 1));
+	compounded.setBlendMode(BLEND_MAX);
+	sequential.setBlendMode(BLEND_MAX);
+
+	std::vector<std::vector<float>> samples;
+	std::vector<ScanLine> lines = randomLines(compounded, 300, 3, samples);
+
+	compounded.addLinesCompounded(lines, pool);
+
+	for (size_t i = 0; i < lines.size(); i++) {
+		sequential.addLine(lines[i].p1, lines[i].p2, lines[i].vals);
+	}
+
+	return countDifferences(compounded, sequential);
+}
+
+int compoundedCheck() {
+	std::cout << "addLinesCompounded() check" << std::endl;
+
+	ThreadPool pool(4);
+	glm::ivec3 dims(50, 40, 60);
+	glm::vec3 spacing(1.0f);
+	int total = 0;
+
+	DensityMap linear(dims, spacing), linearSequential(dims, spacing);
+	total += report("VoxelBuffer", compareCompounded(linear, linearSequential, pool));
+
+	BrickedDensityMap bricked(dims, spacing), brickedSequential(dims, spacing);
+	total += report("BrickBuffer", compareCompounded(bricked, brickedSequential, pool));
+
+	SparseDensityMap sparse(dims, spacing), sparseSequential(dims, spacing);
+	total += report("SparseBuffer", compareCompounded(sparse, sparseSequential, pool));
+
+	return total;
+}
+
+int runChecks() {
+	return stencilCheck() + addLinesCheck() + concurrentCheck() + compoundedCheck();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Checks that the fast ways of filling a density map
+// give the same cells as the simple ways they replace
+// -----
+// These print what they compared to the console and return the number of failures.
+// Run the application with --check to run them instead of the viewer.
+
+// Runs every check below and returns the total number of failures
+int runChecks();
+
+// Compares every FixedStencil<R> with SmoothingStencil(R) for R from 1 to 8, cell by cell,
+// and addLineSmoothed() through them (VoxelBuffer) with the stencil walk (BrickBuffer)
+int stencilCheck();
+
+// Compares addLines() on several threads with addLine() for every line,
+// on every storage, with the window slid so the stored cells wrap around
+int addLinesCheck();
+
+// Compares addLineConcurrent() and addLineSmoothedConcurrent() from several threads
+// with addLine() and addLineSmoothed() one line at a time, under BLEND_MAX
+// (where the order of the lines does not matter)
+int concurrentCheck();
+
+// Compares addLinesCompounded() on several threads with addLine() for every line
+// under BLEND_MAX, on every storage, with the window slid so the stored cells wrap around
+int compoundedCheck();
@@ -1,140 +1,1531 @@
 #include "densityMap.h"
+#include "atomics.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+
+template<typename T, template<typename> class Storage>
+BasicDensityMap<T, Storage>::BasicDensityMap(int dim) : cells(dim, dim, dim), dirty(glm::ivec3(dim)) {
+	// The buffer starts out filled with zeroes
+	// and the scale is exactly dim, like it always was
+	init(glm::ivec3(dim), 1.0f / glm::vec3(float(dim)), glm::vec3(float(dim)));
+}
+
+template<typename T, template<typename> class Storage>
+BasicDensityMap<T, Storage>::BasicDensityMap(glm::ivec3 dims, glm::vec3 spacing) : cells(dims.x, dims.y, dims.z), dirty(dims) {
+	// The buffer starts out filled with zeroes
+	init(dims, spacing, 1.0f / spacing);
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::init(glm::ivec3 dims, glm::vec3 spacing, glm::vec3 scale) {
+	this->dims = dims;
+	this->spacing = spacing;
+	this->scale = scale;
+
+	// The window starts at the world origin
+	origin = glm::ivec3(0);
+	offset = glm::ivec3(0);
+
+	blendMode = BLEND_DEFAULT;
+	interpolation = INTERPOLATE_NEAREST;
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::clear() {
+	// Fills the whole array with zeroes
+	cells.clear();
+	dirty.markAll();
+	mips.clear();
+	accumulator.clear();
+}
+
+// Strides of the storages with a fixed layout, for SmoothingStencil
+// Returns false for every other storage
+template<typename T>
+static bool storageStrides(const VoxelBuffer<T>& cells, size_t& rowStride, size_t& sliceStride) {
+	rowStride = cells.getRowStride();
+	sliceStride = cells.getSliceStride();
+	return true;
+}
+
+template<typename T>
+static bool storageStrides(const MappedBuffer<T>& cells, size_t& rowStride, size_t& sliceStride) {
+	rowStride = cells.getRowStride();
+	sliceStride = cells.getSliceStride();
+	return true;
+}
+
+template<typename Cells>
+static bool storageStrides(const Cells&, size_t&, size_t&) {
+	return false;
+}
+
+// Returns true for the storages that share memory between bricks
+// when a cell is first written (so writes to different bricks
+// from different threads are not safe until the bricks exist)
+template<typename T>
+static bool allocatesOnWrite(const SparseBuffer<T>&) {
+	return true;
+}
+
+template<typename Cells>
+static bool allocatesOnWrite(const Cells&) {
+	return false;
+}
+
+// Returns true for the storages that never move, wipe, or hand out memory
+// when a cell is written, so threads can write cells through atomics
+template<typename T>
+static bool writesInPlace(const VoxelBuffer<T>&) {
+	return true;
+}
+
+template<typename T>
+static bool writesInPlace(const MappedBuffer<T>&) {
+	return true;
+}
+
+template<typename Cells>
+static bool writesInPlace(const Cells&) {
+	return false;
+}
+
+// Raises cell to value unless it is already brighter, like brighten(),
+// while other threads might be doing the same
+template<typename T>
+static void brightenConcurrent(T& cell, float value) {
+	std::atomic<T>& target = asAtomic(cell);
+	T wanted = VoxelTraits<T>::fromFloat(value);
+	T current = target.load(std::memory_order_relaxed);
+
+	while (VoxelTraits<T>::toFloat(current) < value
+		&& !target.compare_exchange_weak(current, wanted, std::memory_order_relaxed)) {
+	}
+}
+
+template<typename T, template<typename> class Storage>
+const SmoothingStencil& BasicDensityMap<T, Storage>::getStencil(int radius) {
+	for (size_t i = 0; i < stencils.size(); i++) {
+		if (stencils[i].getRadius() == radius) {
+			return stencils[i];
+		}
+	}
+
+	size_t rowStride = 0, sliceStride = 0;
+	storageStrides(cells, rowStride, sliceStride);
+
+	stencils.push_back(SmoothingStencil(radius, rowStride, sliceStride));
+	return stencils.back();
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::stamp(const SmoothingStencil& stencil, int x, int y, int z, BlendMode mode) {
+	int radius = stencil.getRadius();
+	const StencilEntry* entries = stencil.getEntries();
+	size_t count = stencil.size();
+
+	// Clips the cube around (x, y, z) to the window
+	int minX = std::max(x - radius, 0), maxX = std::min(x + radius, dims.x - 1);
+	int minY = std::max(y - radius, 0), maxY = std::min(y + radius, dims.y - 1);
+	int minZ = std::max(z - radius, 0), maxZ = std::min(z + radius, dims.z - 1);
+
+	dirty.markBox(glm::ivec3(minX, minY, minZ), glm::ivec3(maxX, maxY, maxZ) + 1);
+
+	if (mode != BLEND_MAX) {
+		// Only brightening has the faster paths below
+		for (size_t k = 0; k < count; k++) {
+			int px = x + entries[k].dx;
+			int py = y + entries[k].dy;
+			int pz = z + entries[k].dz;
+
+			if (px < minX || px > maxX || py < minY || py > maxY || pz < minZ || pz > maxZ) {
+				continue;
+			}
+
+			blend(mode, px, py, pz, entries[k].weight, entries[k].weight, dirty);
+		}
+
+		return;
+	}
+
+	bool inside = minX == x - radius && maxX == x + radius
+		&& minY == y - radius && maxY == y + radius
+		&& minZ == z - radius && maxZ == z + radius;
+
+	if (!inside) {
+		// Near the sides of the window, every cell is checked
+		for (size_t k = 0; k < count; k++) {
+			int px = x + entries[k].dx;
+			int py = y + entries[k].dy;
+			int pz = z + entries[k].dz;
+
+			if (px < minX || px > maxX || py < minY || py > maxY || pz < minZ || pz > maxZ) {
+				continue;
+			}
+
+			brighten(cell(px, py, pz), entries[k].weight, px, py, pz);
+		}
+
+		return;
+	}
+
+	// The stored cube only stays in one piece in memory
+	// if it does not wrap around the end of the storage
+	const ptrdiff_t* offsets = stencil.getOffsets();
+	int cx = wrapX(x), cy = wrapY(y), cz = wrapZ(z);
+
+	if (offsets != nullptr && cx >= radius && cx + radius < dims.x
+		&& cy >= radius && cy + radius < dims.y && cz >= radius && cz + radius < dims.z) {
+		// Every cell is a fixed distance from the centre in memory
+		T* centre = &cells(cx, cy, cz);
+
+		for (size_t k = 0; k < count; k++) {
+			brighten(centre[offsets[k]], entries[k].weight, x + entries[k].dx, y + entries[k].dy, z + entries[k].dz);
+		}
+
+		return;
+	}
+
+	for (size_t k = 0; k < count; k++) {
+		int px = x + entries[k].dx;
+		int py = y + entries[k].dy;
+		int pz = z + entries[k].dz;
+
+		brighten(cell(px, py, pz), entries[k].weight, px, py, pz);
+	}
+}
+
+// ln(1.25), so 1.25 ^ -d is exp(-d * LN_1_25)
+static const float LN_1_25 = 0.22314355f;
+
+// Narrows t0 and t1 to where a + t * d is between lo and hi
+// Returns false if there is no such t
+static bool clipToRange(float a, float d, float lo, float hi, float& t0, float& t1) {
+	if (d == 0.0f) {
+		return lo <= a && a <= hi;
+	}
+
+	float enter = (lo - a) / d;
+	float exit = (hi - a) / d;
+
+	if (enter > exit) {
+		std::swap(enter, exit);
+	}
+
+	t0 = std::max(t0, enter);
+	t1 = std::min(t1, exit);
+
+	return t0 <= t1;
+}
+
+// Squared distances from the cells (x, y, z0) to (x, y, z0 + count - 1)
+// to the segment from a to a + ab
+// -----
+// invLength2 is 1 / |ab|^2, or 0 for a segment that is a point.
+// Every cell is the same few multiplies and adds with no branches
+// (the clamp is a min and a max), so the loop vectorizes over z.
+static void segmentDistances2(glm::vec3 a, glm::vec3 ab, float invLength2, int x, int y, int z0, int count, float* out) {
+	float vx = float(x) - a.x;
+	float vy = float(y) - a.y;
+
+	// The part of the projection that is the same for the whole row
+	float along = (vx * ab.x + vy * ab.y) * invLength2;
+	float stepAlong = ab.z * invLength2;
+
+	for (int k = 0; k < count; k++) {
+		float vz = float(z0 + k) - a.z;
+
+		float t = along + vz * stepAlong;
+		t = std::min(std::max(t, 0.0f), 1.0f);
+
+		float ex = vx - t * ab.x;
+		float ey = vy - t * ab.y;
+		float ez = vz - t * ab.z;
+
+		out[k] = ex * ex + ey * ey + ez * ez;
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::stampCapsule(glm::vec3 a, glm::vec3 b, int radius, BlendMode mode) {
+	if (radius < 0) {
+		return;
+	}
+
+	glm::vec3 ab = b - a;
+	float length2 = glm::dot(ab, ab);
+	float invLength2 = length2 > 0.0f ? 1.0f / length2 : 0.0f;
+	float r = float(radius);
+
+	// Squared distances along one row
+	std::vector<float> distances(dims.z);
+
+	// Every cell in the capsule is within r of its closest point on the segment
+	// along each axis, so each slab and row only has to cover the part
+	// of the segment that is within r of it, plus r on either side.
+	// That keeps the cells looked at close to the capsule itself
+	// instead of its bounding box, even for diagonal segments.
+	int minX = std::max(int(std::ceil(std::min(a.x, b.x) - r)), 0);
+	int maxX = std::min(int(std::floor(std::max(a.x, b.x) + r)), dims.x - 1);
+
+	for (int x = minX; x <= maxX; x++) {
+		float tx0 = 0.0f, tx1 = 1.0f;
+		if (!clipToRange(a.x, ab.x, x - r, x + r, tx0, tx1)) {
+			continue;
+		}
+
+		float y0 = std::min(a.y + tx0 * ab.y, a.y + tx1 * ab.y);
+		float y1 = std::max(a.y + tx0 * ab.y, a.y + tx1 * ab.y);
+		int minY = std::max(int(std::ceil(y0 - r)), 0);
+		int maxY = std::min(int(std::floor(y1 + r)), dims.y - 1);
+
+		for (int y = minY; y <= maxY; y++) {
+			float t0 = tx0, t1 = tx1;
+			if (!clipToRange(a.y, ab.y, y - r, y + r, t0, t1)) {
+				continue;
+			}
+
+			float z0 = std::min(a.z + t0 * ab.z, a.z + t1 * ab.z);
+			float z1 = std::max(a.z + t0 * ab.z, a.z + t1 * ab.z);
+			int minZ = std::max(int(std::ceil(z0 - r)), 0);
+			int maxZ = std::min(int(std::floor(z1 + r)), dims.z - 1);
+
+			if (minZ > maxZ) {
+				continue;
+			}
+
+			int count = maxZ - minZ + 1;
+			segmentDistances2(a, ab, invLength2, x, y, minZ, count, distances.data());
+
+			dirty.markBox(glm::ivec3(x, y, minZ), glm::ivec3(x + 1, y + 1, maxZ + 1));
+
+			for (int k = 0; k < count; k++) {
+				if (distances[k] > r * r) {
+					continue;
+				}
+
+				// Same falloff as the spheres (1.25 ^ -distance), measured from the segment
+				float distance = std::sqrt(distances[k]);
+				float value = std::exp(-distance * LN_1_25);
+
+				if (mode == BLEND_MAX) {
+					brighten(cell(x, y, minZ + k), value, x, y, minZ + k);
+				}
+				else {
+					blend(mode, x, y, minZ + k, value, value, dirty);
+				}
+			}
+		}
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLineSmoothed(glm::vec3 p1, glm::vec3 p2, SampleView vals, int radius, SmoothingShape shape) {
+	int numVals = vals.size();
+	BlendMode mode = blendFor(BLEND_MAX);
+
+	if (shape == SMOOTH_CAPSULE) {
+		// Shifted by half a cell, so cell centres are on whole numbers
+		glm::vec3 a = p1 * scale - glm::vec3(origin) - 0.5f;
+		glm::vec3 b = p2 * scale - glm::vec3(origin) - 0.5f;
+
+		stampCapsule(a, b, radius, mode);
+		return;
+	}
+
+	const SmoothingStencil& stencil = getStencil(radius);
+
+	// The radii used most get a kernel of their own
+	switch (radius) {
+	case 1: addSpheres<1>(p1, p2, numVals, stencil, mode); break;
+	case 2: addSpheres<2>(p1, p2, numVals, stencil, mode); break;
+	case 3: addSpheres<3>(p1, p2, numVals, stencil, mode); break;
+	case 4: addSpheres<4>(p1, p2, numVals, stencil, mode); break;
+	case 5: addSpheres<5>(p1, p2, numVals, stencil, mode); break;
+	case 6: addSpheres<6>(p1, p2, numVals, stencil, mode); break;
+	case 7: addSpheres<7>(p1, p2, numVals, stencil, mode); break;
+	case 8: addSpheres<8>(p1, p2, numVals, stencil, mode); break;
+	default: addSpheres<0>(p1, p2, numVals, stencil, mode); break;
+	}
+}
+
+template<typename T, template<typename> class Storage>
+template<int R>
+void BasicDensityMap<T, Storage>::addSpheres(glm::vec3 p1, glm::vec3 p2, int numVals, const SmoothingStencil& stencil, BlendMode mode) {
+	// The fixed kernels need the strides of the storage,
+	// keep no track of which mip cells to update, and only brighten
+	size_t rowStride = 0, sliceStride = 0;
+	bool fixed = R > 0 && mode == BLEND_MAX && storageStrides(cells, rowStride, sliceStride) && !mips.isEnabled();
+
+	// Stamping the same cell twice changes nothing under these modes,
+	// but the averaging modes count every stamp
+	bool skipRepeats = mode == BLEND_MAX || mode == BLEND_LATEST;
+
+	forEachSampleCell(p1, p2, numVals, stencil.getRadius(), skipRepeats, [&](int x, int y, int z) {
+		if (!fixed || !stampFixed<R>(x, y, z, rowStride, sliceStride)) {
+			stamp(stencil, x, y, z, mode);
+		}
+	});
+}
+
+template<typename T, template<typename> class Storage>
+template<int R>
+bool BasicDensityMap<T, Storage>::stampFixed(int x, int y, int z, size_t rowStride, size_t sliceStride) {
+	// Only spheres inside the window that do not wrap around
+	// the end of the storage are in one piece in memory
+	int cx = wrapX(x), cy = wrapY(y), cz = wrapZ(z);
+
+	if (x < R || x + R >= dims.x || y < R || y + R >= dims.y || z < R || z + R >= dims.z
+		|| cx < R || cx + R >= dims.x || cy < R || cy + R >= dims.y || cz < R || cz + R >= dims.z) {
+		return false;
+	}
+
+	dirty.markBox(glm::ivec3(x - R, y - R, z - R), glm::ivec3(x + R + 1, y + R + 1, z + R + 1));
+
+	const FixedStencilTable<R>& table = FixedStencil<R>::table;
+	T* centre = &cells(cx, cy, cz);
+
+	for (int r = 0; r < table.rowCount; r++) {
+		T* row = centre + table.dx[r] * ptrdiff_t(sliceStride) + table.dy[r] * ptrdiff_t(rowStride) - table.half[r];
+		const float* weight = table.weight + table.start[r];
+		int length = 2 * table.half[r] + 1;
+
+		// Same rule as brighten(), written as a select
+		// so the loop has no branches and vectorizes
+		for (int k = 0; k < length; k++) {
+			row[k] = VoxelTraits<T>::toFloat(row[k]) < weight[k] ? VoxelTraits<T>::fromFloat(weight[k]) : row[k];
+		}
+	}
+
+	return true;
+}
+
+// Clips the segment a + t * d (t from 0 to 1) to the box from boxMin to boxMax
+// -----
+// Returns false if the segment misses the box, and otherwise
+// narrows t0 and t1 to the part of the segment inside it
+static bool clipSegment(glm::vec3 a, glm::vec3 d, glm::vec3 boxMin, glm::vec3 boxMax, float& t0, float& t1) {
+	t0 = 0.0f;
+	t1 = 1.0f;
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (d[axis] == 0.0f) {
+			// Parallel to both faces, so it is either between them or never
+			if (a[axis] < boxMin[axis] || a[axis] >= boxMax[axis]) {
+				return false;
+			}
+
+			continue;
+		}
+
+		float enter = (boxMin[axis] - a[axis]) / d[axis];
+		float exit = (boxMax[axis] - a[axis]) / d[axis];
+
+		if (enter > exit) {
+			std::swap(enter, exit);
+		}
+
+		t0 = std::max(t0, enter);
+		t1 = std::min(t1, exit);
+	}
+
+	return t0 < t1;
+}
+
+template<typename T, template<typename> class Storage>
+template<typename Visit>
+void BasicDensityMap<T, Storage>::forEachSampleCell(glm::vec3 p1, glm::vec3 p2, int count, int margin, bool skipRepeats, Visit visit) const {
+	if (count <= 0) {
+		return;
+	}
+
+	// The first sample and the step between samples, in cells relative to the window
+	glm::vec3 a = p1 * scale - glm::vec3(origin);
+	glm::vec3 step = (p2 - p1) * scale / float(count);
+
+	// Only the samples within margin cells of the window are stepped through,
+	// so the first sample of every batch is inside the box around it,
+	// which is small enough for 16.16 fixed point
+	float t0, t1;
+	glm::vec3 boxMin(-float(margin + 1));
+	glm::vec3 boxMax = glm::vec3(dims) + float(margin + 1);
+
+	if (!clipSegment(a, step * float(count), boxMin, boxMax, t0, t1)) {
+		return;
+	}
+
+	int begin = std::max(0, int(std::ceil(t0 * count)));
+	int end = std::min(count, int(t1 * count) + 1);
+
+	// The offsets of the lanes have to fit in 16.16 fixed point too, which they do not
+	// when samples are more than 32768 / STEP_BATCH cells apart.
+	// Then only a few samples land near the window, so they are worked out one at a time
+	// (and no two are in the same cell)
+	float stride = std::max(std::abs(step.x), std::max(std::abs(step.y), std::abs(step.z)));
+
+	if (stride * STEP_BATCH >= 32767.0f) {
+		for (int i = begin; i < end; i++) {
+			glm::vec3 p = glm::floor(a + float(i) * step);
+			visit(int(p.x), int(p.y), int(p.z));
+		}
+
+		return;
+	}
+
+	// Offset of every lane from the first sample of its batch, in 16.16 fixed point
+	const float one = 65536.0f;
+	int32_t laneX[STEP_BATCH], laneY[STEP_BATCH], laneZ[STEP_BATCH];
+
+	for (int k = 0; k < STEP_BATCH; k++) {
+		laneX[k] = int32_t(std::floor(k * step.x * one + 0.5f));
+		laneY[k] = int32_t(std::floor(k * step.y * one + 0.5f));
+		laneZ[k] = int32_t(std::floor(k * step.z * one + 0.5f));
+	}
+
+	int cellX[STEP_BATCH], cellY[STEP_BATCH], cellZ[STEP_BATCH];
+	glm::ivec3 last(INT_MIN);
+
+	for (int first = begin; first < end; first += STEP_BATCH) {
+		int batch = std::min(STEP_BATCH, end - first);
+
+		// Where the batch starts, worked out from its index so no error builds up
+		int32_t baseX = int32_t(std::floor((a.x + first * step.x) * one + 0.5f));
+		int32_t baseY = int32_t(std::floor((a.y + first * step.y) * one + 0.5f));
+		int32_t baseZ = int32_t(std::floor((a.z + first * step.z) * one + 0.5f));
+
+		// One add and one shift per lane (the shift rounds down, negative positions too),
+		// for the whole batch at once so the compiler vectorizes it.
+		// Lanes past the end are worked out and ignored, so they add in unsigned
+		// to wrap instead of overflowing
+		for (int k = 0; k < STEP_BATCH; k++) {
+			cellX[k] = int32_t(uint32_t(baseX) + uint32_t(laneX[k])) >> 16;
+			cellY[k] = int32_t(uint32_t(baseY) + uint32_t(laneY[k])) >> 16;
+			cellZ[k] = int32_t(uint32_t(baseZ) + uint32_t(laneZ[k])) >> 16;
+		}
+
+		for (int k = 0; k < batch; k++) {
+			glm::ivec3 c(cellX[k], cellY[k], cellZ[k]);
+
+			// Samples are in order along the line, so repeats are next to each other
+			if (skipRepeats && c == last) {
+				continue;
+			}
+
+			visit(c.x, c.y, c.z);
+			last = c;
+		}
+	}
+}
+
+template<typename T, template<typename> class Storage>
+template<typename Visit>
+void BasicDensityMap<T, Storage>::walkLine(glm::vec3 p1, glm::vec3 p2, SampleView vals, glm::ivec3 boxMin, glm::ivec3 boxMax, Visit visit) const {
+	int numVals = vals.size();
+
+	if (numVals == 0) {
+		return;
+	}
+
+	// The line in cells, relative to the window
+	glm::vec3 a = p1 * scale - glm::vec3(origin);
+	glm::vec3 d = p2 * scale - glm::vec3(origin) - a;
+	float length = glm::length(d);
+
+	// The part of the line inside the box, found once
+	// so the loop below never has to check bounds
+	float t0, t1;
+	if (!clipSegment(a, d, glm::vec3(boxMin), glm::vec3(boxMax), t0, t1)) {
+		return;
+	}
+
+	// First and last cells on the line
+	// (clamped, since a point on the far face of the box is just outside it)
+	glm::ivec3 first = glm::clamp(glm::ivec3(glm::floor(a + t0 * d)), boxMin, boxMax - 1);
+	glm::ivec3 last = glm::clamp(glm::ivec3(glm::floor(a + t1 * d)), boxMin, boxMax - 1);
+
+	// Amanatides-Woo traversal
+	// -----
+	// step is the direction the cell moves in along each axis,
+	// tMax is the t where the line crosses into the next cell along each axis,
+	// and tDelta is how much t grows from one crossing to the next.
+	// The line crosses exactly |last - first| faces along each axis,
+	// and counting them keeps the traversal inside the box
+	// even when rounding makes two crossings look out of order.
+	glm::ivec3 step, remaining;
+	glm::vec3 tMax, tDelta;
+	const float never = std::numeric_limits<float>::infinity();
+
+	for (int axis = 0; axis < 3; axis++) {
+		remaining[axis] = std::abs(last[axis] - first[axis]);
+
+		if (d[axis] > 0.0f) {
+			step[axis] = 1;
+			tMax[axis] = (first[axis] + 1 - a[axis]) / d[axis];
+			tDelta[axis] = 1.0f / d[axis];
+		}
+		else if (d[axis] < 0.0f) {
+			step[axis] = -1;
+			tMax[axis] = (first[axis] - a[axis]) / d[axis];
+			tDelta[axis] = -1.0f / d[axis];
+		}
+		else {
+			step[axis] = 0;
+			tMax[axis] = never;
+			tDelta[axis] = never;
+		}
+
+		if (remaining[axis] == 0) {
+			tMax[axis] = never;
+		}
+	}
+
+	// Cells waiting for their interpolated values, WALK_BATCH at a time:
+	// the cell, its weight, and the middle of its part of the line in samples
+	// (sample i is centred on i, so 2.25 is a quarter of the way from sample 2 to sample 3)
+	int cellX[WALK_BATCH], cellY[WALK_BATCH], cellZ[WALK_BATCH];
+	float cellWeight[WALK_BATCH], position[WALK_BATCH];
+	int batch = 0;
+
+	// The samples around every cell of the batch (tap 1 and 2 on either side,
+	// tap 0 and 3 one further out, clamped to the ends of the line) and the results
+	float taps[4][WALK_BATCH], result[WALK_BATCH];
+	int lastVal = numVals - 1;
+	bool cubic = interpolation == INTERPOLATE_CATMULL_ROM;
+
+	// Interpolates the values of the batch and visits its cells
+	auto visitBatch = [&]() {
+		int below[WALK_BATCH];
+		float fraction[WALK_BATCH];
+
+		// floor(), written the way addLineSplatted() does, so this vectorizes
+		for (int k = 0; k < WALK_BATCH; k++) {
+			int i = int(position[k]);
+			i -= position[k] < float(i);
+
+			below[k] = i;
+			fraction[k] = position[k] - float(i);
+		}
+
+		// Reading the samples is a gather, one at a time
+		for (int k = 0; k < batch; k++) {
+			int i = below[k];
+
+			taps[1][k] = vals[std::min(std::max(i, 0), lastVal)];
+			taps[2][k] = vals[std::min(std::max(i + 1, 0), lastVal)];
+
+			if (cubic) {
+				taps[0][k] = vals[std::min(std::max(i - 1, 0), lastVal)];
+				taps[3][k] = vals[std::min(std::max(i + 2, 0), lastVal)];
+			}
+		}
+
+		// The same steps for every cell and no branches, so these vectorize
+		if (cubic) {
+			for (int k = 0; k < WALK_BATCH; k++) {
+				float f = fraction[k], f2 = f * f, f3 = f2 * f;
+
+				float spline = 0.5f * ((-f3 + 2.0f * f2 - f) * taps[0][k]
+					+ (3.0f * f3 - 5.0f * f2 + 2.0f) * taps[1][k]
+					+ (-3.0f * f3 + 4.0f * f2 + f) * taps[2][k]
+					+ (f3 - f2) * taps[3][k]);
+
+				// The spline overshoots next to sharp edges,
+				// so it is kept between the lowest and the highest of the four samples
+				float low = std::min(std::min(taps[0][k], taps[1][k]), std::min(taps[2][k], taps[3][k]));
+				float high = std::max(std::max(taps[0][k], taps[1][k]), std::max(taps[2][k], taps[3][k]));
+				result[k] = std::min(std::max(spline, low), high);
+			}
+		}
+		else {
+			for (int k = 0; k < WALK_BATCH; k++) {
+				result[k] = taps[1][k] + fraction[k] * (taps[2][k] - taps[1][k]);
+			}
+		}
+
+		for (int k = 0; k < batch; k++) {
+			visit(cellX[k], cellY[k], cellZ[k], result[k], cellWeight[k]);
+		}
+
+		batch = 0;
+	};
+
+	// Lanes past the end of a short batch are worked out and ignored,
+	// so they start out as something harmless
+	for (int k = 0; k < WALK_BATCH; k++) {
+		position[k] = 0.0f;
+		taps[0][k] = taps[1][k] = taps[2][k] = taps[3][k] = 0.0f;
+	}
+
+	glm::ivec3 c = first;
+	float tEnter = t0;
+	int cellsLeft = remaining.x + remaining.y + remaining.z + 1;
+
+	while (cellsLeft-- > 0) {
+		// Axis of the next crossing
+		int axis = tMax.x < tMax.y ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+		float tExit = std::min(tMax[axis], t1);
+		float tMiddle = (tEnter + tExit) * 0.5f;
+
+		if (interpolation == INTERPOLATE_NEAREST) {
+			// Each cell gets the sample whose stretch of the line
+			// holds the middle of the part of the line inside the cell
+			int i = std::min(int(tMiddle * numVals), lastVal);
+
+			visit(c.x, c.y, c.z, vals[i], (tExit - tEnter) * length);
+		}
+		else {
+			cellX[batch] = c.x;
+			cellY[batch] = c.y;
+			cellZ[batch] = c.z;
+			cellWeight[batch] = (tExit - tEnter) * length;
+			position[batch] = tMiddle * numVals - 0.5f;
+
+			if (++batch == WALK_BATCH) {
+				visitBatch();
+			}
+		}
+
+		if (cellsLeft == 0) {
+			break;
+		}
+
+		// Move into the next cell
+		c[axis] += step[axis];
+		tEnter = tExit;
+		tMax[axis] += tDelta[axis];
+
+		if (--remaining[axis] == 0) {
+			tMax[axis] = never;
+		}
+	}
+
+	if (batch > 0) {
+		visitBatch();
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLine(glm::vec3 p1, glm::vec3 p2, SampleView vals) {
+	BlendMode mode = blendFor(BLEND_LATEST);
+
+	walkLine(p1, p2, vals, glm::ivec3(0), dims, [&](int x, int y, int z, float value, float weight) {
+		blend(mode, x, y, z, value, weight, dirty);
+	});
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLineSplatted(glm::vec3 p1, glm::vec3 p2, SampleView vals) {
+	int numVals = vals.size();
+
+	if (numVals == 0) {
+		return;
+	}
+
+	BlendMode mode = blendFor(BLEND_WEIGHTED_MEAN);
+
+	// BLEND_DEFAULT has no sums until the first splat
+	if (blendAccumulates(mode) && !accumulator.isEnabled()) {
+		accumulator.enable(dims, mode, 0.0f);
+	}
+
+	// The first sample and the step between samples, in cells relative to the window,
+	// shifted by half a cell so cell centres are on whole numbers
+	glm::vec3 step = (p2 - p1) * scale / float(numVals);
+	glm::vec3 a = p1 * scale - glm::vec3(origin) - 0.5f + 0.5f * step;
+
+	// Lowest of the 8 cells around every sample of the batch
+	int baseX[SPLAT_BATCH], baseY[SPLAT_BATCH], baseZ[SPLAT_BATCH];
+
+	// Weight of every corner for every sample of the batch
+	// Corner c is the cell base + (c >> 2, (c >> 1) & 1, c & 1)
+	float weights[8][SPLAT_BATCH];
+
+	for (int first = 0; first < numVals; first += SPLAT_BATCH) {
+		int count = std::min(SPLAT_BATCH, numVals - first);
+
+		// The whole batch goes through every step together (samples past the end
+		// are worked out and then ignored), so none of these loops branch
+		for (int k = 0; k < SPLAT_BATCH; k++) {
+			float i = float(first + k);
+
+			float x = a.x + i * step.x;
+			float y = a.y + i * step.y;
+			float z = a.z + i * step.z;
+
+			// Rounds towards zero and then down by one where that rounded up,
+			// which is floor() written in a way the compiler vectorizes
+			int ix = int(x);
+			int iy = int(y);
+			int iz = int(z);
+
+			ix -= x < float(ix);
+			iy -= y < float(iy);
+			iz -= z < float(iz);
+
+			baseX[k] = ix;
+			baseY[k] = iy;
+			baseZ[k] = iz;
+
+			float fx = x - float(ix), gx = 1.0f - fx;
+			float fy = y - float(iy), gy = 1.0f - fy;
+			float fz = z - float(iz), gz = 1.0f - fz;
+
+			weights[0][k] = gx * gy * gz;
+			weights[1][k] = gx * gy * fz;
+			weights[2][k] = gx * fy * gz;
+			weights[3][k] = gx * fy * fz;
+			weights[4][k] = fx * gy * gz;
+			weights[5][k] = fx * gy * fz;
+			weights[6][k] = fx * fy * gz;
+			weights[7][k] = fx * fy * fz;
+		}
+
+		for (int k = 0; k < count; k++) {
+			float value = vals[first + k];
+
+			for (int c = 0; c < 8; c++) {
+				int x = baseX[k] + (c >> 2);
+				int y = baseY[k] + ((c >> 1) & 1);
+				int z = baseZ[k] + (c & 1);
+				float weight = weights[c][k];
+
+				// Corners outside the window are dropped, and so are corners
+				// with no weight (the sample is level with the cell before them)
+				if (weight <= 0.0f || x < 0 || x >= dims.x || y < 0 || y >= dims.y || z < 0 || z >= dims.z) {
+					continue;
+				}
+
+				blend(mode, x, y, z, value, weight, dirty);
+			}
+		}
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addFrame(const glm::mat4& pose, const FrameGeometry& geometry, SampleView samples,
+	ReconstructionMode reconstruction, ThreadPool& pool) {
+	if (frameLut.getGeometry() != geometry) {
+		frameLut = FrameLut(geometry);
+	}
+
+	size_t count = frameLut.size();
+
+	if (samples.size() < count) {
+		throw std::invalid_argument("addFrame() needs lines * samplesPerLine samples");
+	}
+
+	if (reconstruction == RECONSTRUCT_BACKWARD) {
+		addFrameBackward(pose, samples, pool);
+		return;
+	}
+
+	BlendMode mode = blendFor(BLEND_LATEST);
+
+	// Probe space to cells of the window:
+	// the pose, then the scale of every row, then the window origin
+	glm::mat4 toCells = pose;
+
+	for (int column = 0; column < 4; column++) {
+		toCells[column] = glm::vec4(glm::vec3(toCells[column]) * scale, toCells[column].w);
+	}
 
-DensityMap::DensityMap(int dim) {
-	this->dim = dim;
+	toCells[3] -= glm::vec4(glm::vec3(origin), 0.0f);
 
-	// Initializing the array and filling it with zeroes
-	for (int i = 0; i < dim; i++) {
-		cells.push_back(std::vector<std::vector<float>>{});
+	const float m00 = toCells[0][0], m01 = toCells[1][0], m02 = toCells[2][0], m03 = toCells[3][0];
+	const float m10 = toCells[0][1], m11 = toCells[1][1], m12 = toCells[2][1], m13 = toCells[3][1];
+	const float m20 = toCells[0][2], m21 = toCells[1][2], m22 = toCells[2][2], m23 = toCells[3][2];
 
-		for (int j = 0; j < dim; j++) {
-			cells.back().push_back(std::vector<float>{});
+	const float* lutX = frameLut.getX();
+	const float* lutY = frameLut.getY();
+	const float* lutZ = frameLut.getZ();
 
-			for (int k = 0; k < dim; k++) {
-				cells.back().back().push_back(0);
-			}
+	// Cell of every sample of the batch
+	int cellX[FRAME_BATCH], cellY[FRAME_BATCH], cellZ[FRAME_BATCH];
+
+	// Samples are usually much closer together than cells, and under BLEND_LATEST
+	// and BLEND_MAX a run of samples in the same cell ends up the same as one write
+	// (of the last or the brightest), so runs are folded into pending first
+	bool folds = mode == BLEND_LATEST || mode == BLEND_MAX;
+	glm::ivec3 pending(-1);
+	float pendingValue = 0.0f;
+
+	for (size_t first = 0; first < count; first += FRAME_BATCH) {
+		int batch = int(std::min(size_t(FRAME_BATCH), count - first));
+
+		// Same steps for every sample and no branches, so this vectorizes
+		for (int k = 0; k < batch; k++) {
+			float px = lutX[first + k];
+			float py = lutY[first + k];
+			float pz = lutZ[first + k];
+
+			float x = m00 * px + m01 * py + m02 * pz + m03;
+			float y = m10 * px + m11 * py + m12 * pz + m13;
+			float z = m20 * px + m21 * py + m22 * pz + m23;
+
+			// floor(), written the way addLineSplatted() does
+			int ix = int(x);
+			int iy = int(y);
+			int iz = int(z);
+
+			cellX[k] = ix - (x < float(ix));
+			cellY[k] = iy - (y < float(iy));
+			cellZ[k] = iz - (z < float(iz));
 		}
-	}
-}
 
-void DensityMap::clear() {
-	// Fills the whole array with zeroes
+		for (int k = 0; k < batch; k++) {
+			int x = cellX[k], y = cellY[k], z = cellZ[k];
+
+			// One compare per axis also drops negative cells
+			if (unsigned(x) >= unsigned(dims.x) || unsigned(y) >= unsigned(dims.y) || unsigned(z) >= unsigned(dims.z)) {
+				continue;
+			}
+
+			float value = samples[first + k];
+
+			if (!folds) {
+				blend(mode, x, y, z, value, 1.0f, dirty);
+				continue;
+			}
 
-	for (int i = 0; i < dim; i++) {
-		for (int j = 0; j < dim; j++) {
-			for (int k = 0; k < dim; k++) {
-				cells[i][j][k] = 0;
+			if (pending == glm::ivec3(x, y, z)) {
+				pendingValue = mode == BLEND_MAX ? std::max(pendingValue, value) : value;
+				continue;
 			}
+
+			if (pending.x >= 0) {
+				blend(mode, pending.x, pending.y, pending.z, pendingValue, 1.0f, dirty);
+			}
+
+			pending = glm::ivec3(x, y, z);
+			pendingValue = value;
 		}
 	}
+
+	if (pending.x >= 0) {
+		blend(mode, pending.x, pending.y, pending.z, pendingValue, 1.0f, dirty);
+	}
 }
 
-void DensityMap::addLineSmoothed(glm::vec3 p1, glm::vec3 p2, std::vector<float> vals, int radius) {
-	int numVals = vals.size();
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addFrameBackward(const glm::mat4& pose, SampleView samples, ThreadPool& pool) {
+	const FrameGeometry& geometry = frameLut.getGeometry();
+
+	if (geometry.lines <= 0 || geometry.samplesPerLine <= 0 || geometry.depth <= 0.0f) {
+		return;
+	}
+
+	BlendMode mode = blendFor(BLEND_LATEST);
+
+	float halfAngle = 0.5f * geometry.sectorAngle;
+	float depth = geometry.depth;
+	float cosHalf = std::cos(halfAngle);
+
+	// Window cells to probe space: the centre of the cell in world units,
+	// then back through the pose
+	glm::vec3 size = 1.0f / scale;
+	glm::mat4 fromCells(1.0f);
+	fromCells[0][0] = size.x;
+	fromCells[1][1] = size.y;
+	fromCells[2][2] = size.z;
+	fromCells[3] = glm::vec4((glm::vec3(origin) + 0.5f) * size, 1.0f);
+
+	glm::mat4 toProbe = glm::inverse(pose) * fromCells;
+
+	// How far one cell along x, y, and z moves in probe space
+	glm::vec3 stepX(toProbe[0]);
+	glm::vec3 stepY(toProbe[1]);
+	glm::vec3 stepZ(toProbe[2]);
+	glm::vec3 base(toProbe[3]);
+
+	// The plane of the frame (y = 0) passes through a cell
+	// if its centre is closer to it than half the cell reaches across it
+	float thickness = 0.5f * (std::abs(stepX.y) + std::abs(stepY.y) + std::abs(stepZ.y));
+
+	// Box of cells around the fan: the rectangle around the fan in probe space,
+	// moved into cells, plus the cells the plane passes through on either side
+	float sideX = halfAngle < 1.57079633f ? depth * std::sin(halfAngle) : depth;
+	float nearZ = std::min(0.0f, depth * cosHalf);
+	glm::mat4 toCells = glm::inverse(toProbe);
+
+	glm::vec3 low(std::numeric_limits<float>::max());
+	glm::vec3 high(-std::numeric_limits<float>::max());
 
-	// x, y, and z coordinates of the current data point
-	// Moves along the line defined by p1 and p2
-	float x = p1.x;
-	float y = p1.y;
-	float z = p1.z;
-
-	// Direction of the line defined by p1 and p2
-	float dx = (p2.x - p1.x) / numVals;
-	float dy = (p2.y - p1.y) / numVals;
-	float dz = (p2.z - p1.z) / numVals;
-
-	for (int i = 0; i < numVals; i++) {
-		// Cell index determined by x, y, and z
-		int ix = x * dim;
-		int iy = y * dim;
-		int iz = z * dim;
-
-		// Iterates through a cube around (ix, iy, iz)
-		for (int rx = -radius; rx <= radius; rx++) {
-			for (int ry = -radius; ry <= radius; ry++) {
-				for (int rz = -radius; rz <= radius; rz++) {
-					// Disregards cells out of bounds
-					if (ix + rx < 0 || ix + rx >= dim ||
-						iy + ry < 0 || iy + ry >= dim ||
-						iz + rz < 0 || iz + rz >= dim) {
-						
+	for (int corner = 0; corner < 4; corner++) {
+		glm::vec4 p((corner & 1) ? sideX : -sideX, 0.0f, (corner & 2) ? depth : nearZ, 1.0f);
+		glm::vec3 c(toCells * p);
+
+		low = glm::min(low, c);
+		high = glm::max(high, c);
+	}
+
+	glm::vec3 clampLow(-1.0f), clampHigh = glm::vec3(dims) + 1.0f;
+	glm::ivec3 boxMin = glm::max(glm::ivec3(glm::floor(glm::clamp(low, clampLow, clampHigh))) - 1, glm::ivec3(0));
+	glm::ivec3 boxMax = glm::min(glm::ivec3(glm::ceil(glm::clamp(high, clampLow, clampHigh))) + 2, dims);
+
+	if (glm::any(glm::greaterThanEqual(boxMin, boxMax))) {
+		return;
+	}
+
+	// Calls visit(x, y, z, p, r) for every cell with window x from minX to maxX - 1
+	// whose centre is inside the fan, with p the centre in probe space
+	// and r its distance from the probe
+	float depth2 = depth * depth;
+
+	auto walkRange = [&](int minX, int maxX, auto visit) {
+		minX = std::max(minX, boxMin.x);
+		maxX = std::min(maxX, boxMax.x);
+
+		for (int x = minX; x < maxX; x++) {
+			for (int y = boxMin.y; y < boxMax.y; y++) {
+				glm::vec3 row = base + float(x) * stepX + float(y) * stepY;
+
+				// Cuts the row down to the cells the plane passes through,
+				// where |row.y + z * stepZ.y| <= thickness
+				int minZ = boxMin.z, maxZ = boxMax.z;
+
+				if (stepZ.y != 0.0f) {
+					float z0 = (-thickness - row.y) / stepZ.y;
+					float z1 = (thickness - row.y) / stepZ.y;
+
+					if (z0 > z1) {
+						std::swap(z0, z1);
+					}
+
+					minZ = int(std::ceil(std::max(z0, float(minZ))));
+					maxZ = int(std::floor(std::min(z1, float(maxZ - 1)))) + 1;
+				}
+				else if (std::abs(row.y) > thickness) {
+					continue;
+				}
+
+				for (int z = minZ; z < maxZ; z++) {
+					glm::vec3 p = row + float(z) * stepZ;
+					float r2 = p.x * p.x + p.z * p.z;
+
+					if (r2 > depth2) {
 						continue;
 					}
 
-					// Disregards cells outside of the sphere
-					if (rx * rx + ry * ry + rz * rz > radius * radius) {
+					// Inside the sector if the angle from +z is at most halfAngle,
+					// which is the same as cos(angle) = p.z / r >= cos(halfAngle)
+					float r = std::sqrt(r2);
+
+					if (p.z < r * cosHalf) {
 						continue;
 					}
 
-					// Finds the position of the cell about to be modified
-					float absx = x * dim + float(rx);
-					float absy = y * dim + float(ry);
-					float absz = z * dim + float(rz);
+					visit(x, y, z, p, r);
+				}
+			}
+		}
+	};
+
+	// Bilinear lookup in the frame, between the two lines on either side
+	// and the two samples on either side along each
+	int lines = geometry.lines;
+	int samplesPerLine = geometry.samplesPerLine;
+	float lastLine = float(lines - 1);
+	float lastSample = float(samplesPerLine - 1);
+	float lineScale = geometry.sectorAngle > 0.0f ? lastLine / geometry.sectorAngle : 0.0f;
+	float sampleScale = samplesPerLine / depth;
+
+	auto lookUp = [&](glm::vec3 p, float r) {
+		float u = (std::atan2(p.x, p.z) + halfAngle) * lineScale;
+		float v = r * sampleScale - 0.5f;
+
+		u = std::min(std::max(u, 0.0f), lastLine);
+		v = std::min(std::max(v, 0.0f), lastSample);
+
+		int i0 = int(u), i1 = std::min(i0 + 1, lines - 1);
+		int j0 = int(v), j1 = std::min(j0 + 1, samplesPerLine - 1);
+		float fu = u - i0;
+		float fv = v - j0;
+
+		size_t a = size_t(i0) * samplesPerLine;
+		size_t b = size_t(i1) * samplesPerLine;
+
+		float a0 = samples[a + j0], a1 = samples[a + j1];
+		float b0 = samples[b + j0], b1 = samples[b + j1];
+
+		float nearLine = a0 + fv * (a1 - a0);
+		float farLine = b0 + fv * (b1 - b0);
+
+		return nearLine + fu * (farLine - nearLine);
+	};
+
+	if (writesSequentially(pool.getThreadCount())) {
+		walkRange(0, dims.x, [&](int x, int y, int z, glm::vec3 p, float r) {
+			blend(mode, x, y, z, lookUp(p, r), 1.0f, dirty);
+		});
+
+		return;
+	}
+
+	// Gives every brick about to be written its memory up front
+	preallocateBricks(blendAccumulates(mode), [&](auto prepare) {
+		walkRange(0, dims.x, [&](int x, int y, int z, glm::vec3 /*p*/, float /*r*/) {
+			prepare(wrapX(x), wrapY(y), wrapZ(z));
+		});
+	});
+
+	// Every cell only depends on the frame, so the slabs need no order
+	forEachSlab(pool, [&](int minX, int maxX, DirtyRegion& marked) {
+		walkRange(minX, maxX, [&](int x, int y, int z, glm::vec3 p, float r) {
+			blend(mode, x, y, z, lookUp(p, r), 1.0f, marked);
+		});
+	});
+}
+
+template<typename T, template<typename> class Storage>
+template<typename ForEachCell>
+void BasicDensityMap<T, Storage>::preallocateBricks(bool averages, ForEachCell forEachCell) {
+	if (!averages && !allocatesOnWrite(cells)) {
+		return;
+	}
+
+	glm::ivec3 lastBrick(-1);
+
+	forEachCell([&](int x, int y, int z) {
+		glm::ivec3 brick = glm::ivec3(x, y, z) >> BRICK_SHIFT;
+
+		if (brick == lastBrick) {
+			return;
+		}
+
+		if (averages) {
+			accumulator.prepare(x, y, z);
+		}
+		else {
+			cells(x, y, z);
+		}
+
+		lastBrick = brick;
+	});
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLines(const std::vector<ScanLine>& lines, ThreadPool& pool) {
+	int lineCount = int(lines.size());
+	BlendMode mode = blendFor(BLEND_LATEST);
+
+	if (writesSequentially(pool.getThreadCount())) {
+		for (int i = 0; i < lineCount; i++) {
+			addLine(lines[i].p1, lines[i].p2, lines[i].vals);
+		}
+
+		return;
+	}
+
+	// Walks every line on its own, which only reads the map
+	if (int(lineWrites.size()) < lineCount) {
+		lineWrites.resize(lineCount);
+	}
+
+	pool.parallelFor(lineCount, [&](int i, int /*thread*/) {
+		std::vector<CellWrite>& writes = lineWrites[i];
+		writes.clear();
+
+		walkLine(lines[i].p1, lines[i].p2, lines[i].vals, glm::ivec3(0), dims, [&](int x, int y, int z, float value, float weight) {
+			CellWrite write = { x, y, z, value, weight };
+			writes.push_back(write);
+		});
+	});
+
+	preallocateBricks(blendAccumulates(mode), [&](auto prepare) {
+		for (int i = 0; i < lineCount; i++) {
+			for (size_t k = 0; k < lineWrites[i].size(); k++) {
+				const CellWrite& w = lineWrites[i][k];
+				prepare(wrapX(w.x), wrapY(w.y), wrapZ(w.z));
+			}
+		}
+	});
+
+	// Writes the cells slab by slab (see forEachSlab())
+	// Each slab sees the lines in the same order addLine() would,
+	// so every cell ends up with the same value.
+	// -----
+	// The cells of a line with window x from minX to maxX - 1 are next to
+	// each other in its list, since x only ever moves one way along a line
+	forEachSlab(pool, [&](int minX, int maxX, DirtyRegion& marked) {
+		for (int i = 0; i < lineCount; i++) {
+			const std::vector<CellWrite>& writes = lineWrites[i];
+
+			if (writes.empty()) {
+				continue;
+			}
+
+			size_t begin, end;
+
+			if (writes.front().x <= writes.back().x) {
+				begin = std::partition_point(writes.begin(), writes.end(), [&](const CellWrite& w) { return w.x < minX; }) - writes.begin();
+				end = std::partition_point(writes.begin() + begin, writes.end(), [&](const CellWrite& w) { return w.x < maxX; }) - writes.begin();
+			}
+			else {
+				begin = std::partition_point(writes.begin(), writes.end(), [&](const CellWrite& w) { return w.x >= maxX; }) - writes.begin();
+				end = std::partition_point(writes.begin() + begin, writes.end(), [&](const CellWrite& w) { return w.x >= minX; }) - writes.begin();
+			}
+
+			for (size_t k = begin; k < end; k++) {
+				const CellWrite& w = writes[k];
+				blend(mode, w.x, w.y, w.z, w.value, w.weight, marked);
+			}
+		}
+	});
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLinesCompounded(const std::vector<ScanLine>& lines, ThreadPool& pool) {
+	BlendMode mode = blendFor(BLEND_MAX);
+
+	// Only the maximum and the sums can be split up and put back together
+	if (mode != BLEND_MAX && mode != BLEND_MEAN && mode != BLEND_WEIGHTED_MEAN) {
+		addLines(lines, pool);
+		return;
+	}
+
+	int threadCount = pool.getThreadCount();
+
+	if (int(partials.size()) < threadCount) {
+		partials.resize(threadCount);
+	}
+
+	for (int t = 0; t < threadCount; t++) {
+		partials[t].reset(dims, mode);
+	}
+
+	// Every thread adds its lines to its own volume
+	pool.parallelFor(int(lines.size()), [&](int i, int thread) {
+		PartialVolume& partial = partials[thread];
+
+		walkLine(lines[i].p1, lines[i].p2, lines[i].vals, glm::ivec3(0), dims, [&](int x, int y, int z, float value, float weight) {
+			partial.add(wrapX(x), wrapY(y), wrapZ(z), value, weight);
+		});
+	});
+
+	// Every brick any thread got values in, once
+	std::vector<size_t> bricks;
 
-					// The distance between (absx, absy, absz) and (ix, iy, iz)
-					float distance = sqrt(pow(absx - ix, 2) + pow(absy - iy, 2) + pow(absz - iz, 2));
+	for (int t = 0; t < threadCount; t++) {
+		bricks.insert(bricks.end(), partials[t].getBricks().begin(), partials[t].getBricks().end());
+	}
+
+	std::sort(bricks.begin(), bricks.end());
+	bricks.erase(std::unique(bricks.begin(), bricks.end()), bricks.end());
+
+	int brickCount = int(bricks.size());
+	bool averages = mode != BLEND_MAX;
+
+	// Merges every volume's share of one stored brick into the map,
+	// marking the cells (at their place in the window) in marked
+	auto mergeBrick = [&](int b, DirtyRegion& marked) {
+		size_t brick = bricks[b];
+		glm::ivec3 first = partials[0].brickOrigin(brick);
+		glm::ivec3 last = glm::min(first + BRICK_SIZE, dims);
 
-					// The index of the cell about to be modified
-					int px = ix + rx;
-					int py = iy + ry;
-					int pz = iz + rz;
+		for (int x = first.x; x < last.x; x++) {
+			for (int y = first.y; y < last.y; y++) {
+				for (int z = first.z; z < last.z; z++) {
+					size_t local = brickLocalIndex(x, y, z);
+					float value = 0.0f;
+					float weight = 0.0f;
 
-					// The brightness of the cell
-					float n = pow(1.25, -distance);
+					for (int t = 0; t < threadCount; t++) {
+						const float* values = partials[t].brickValues(brick);
 
-					// Does not turn bright cells darker
-					if (cells[px][py][pz] < n) {
-						cells[px][py][pz] = n;
+						if (values == nullptr) {
+							continue;
+						}
+
+						if (averages) {
+							value += values[local];
+							weight += partials[t].brickWeights(brick)[local];
+						}
+						else {
+							value = std::max(value, values[local]);
+						}
+					}
+
+					if (averages) {
+						if (weight > 0.0f) {
+							accumulator.addSum(x, y, z, value, weight);
+						}
+					}
+					else if (value > 0.0f) {
+						glm::ivec3 window = storedToWindow(glm::ivec3(x, y, z));
+						brighten(cells(x, y, z), value, window.x, window.y, window.z);
+						marked.markCell(window.x, window.y, window.z);
 					}
 				}
 			}
 		}
+	};
+
+	if (writesSequentially(threadCount)) {
+		for (int b = 0; b < brickCount; b++) {
+			mergeBrick(b, dirty);
+		}
+
+		return;
+	}
+
+	preallocateBricks(averages, [&](auto prepare) {
+		for (int b = 0; b < brickCount; b++) {
+			glm::ivec3 first = partials[0].brickOrigin(bricks[b]);
+			prepare(first.x, first.y, first.z);
+		}
+	});
+
+	std::vector<DirtyRegion> threadDirty(threadCount, DirtyRegion(dims));
+
+	pool.parallelFor(brickCount, [&](int b, int thread) {
+		mergeBrick(b, threadDirty[thread]);
+	});
+
+	for (size_t i = 0; i < threadDirty.size(); i++) {
+		dirty.merge(threadDirty[i]);
+	}
+}
+
+template<typename T, template<typename> class Storage>
+template<typename WriteRange>
+void BasicDensityMap<T, Storage>::forEachSlab(ThreadPool& pool, WriteRange writeRange) {
+	int slabCount = (dims.x + BRICK_SIZE - 1) / BRICK_SIZE;
+	std::vector<DirtyRegion> threadDirty(pool.getThreadCount(), DirtyRegion(dims));
+
+	pool.parallelFor(slabCount, [&](int slab, int thread) {
+		// The stored slab, and where it starts in the window
+		int first = slab * BRICK_SIZE;
+		int count = std::min(BRICK_SIZE, dims.x - first);
+		int windowX = (first - offset.x + dims.x) % dims.x;
+
+		// A stored slab is two pieces of the window if it holds its last and first cells
+		if (windowX + count <= dims.x) {
+			writeRange(windowX, windowX + count, threadDirty[thread]);
+		}
+		else {
+			writeRange(windowX, dims.x, threadDirty[thread]);
+			writeRange(0, windowX + count - dims.x, threadDirty[thread]);
+		}
+	});
+
+	for (size_t i = 0; i < threadDirty.size(); i++) {
+		dirty.merge(threadDirty[i]);
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::checkConcurrent(BlendMode mode) const {
+	if (!writesInPlace(cells)) {
+		throw std::logic_error("Concurrent insertion needs a storage that writes cells in place (VoxelBuffer or MappedBuffer)");
+	}
+
+	if (blendAccumulates(mode)) {
+		throw std::logic_error("Concurrent insertion cannot average (use BLEND_LATEST or BLEND_MAX)");
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLineConcurrent(glm::vec3 p1, glm::vec3 p2, SampleView vals) {
+	BlendMode mode = blendFor(BLEND_LATEST);
+	checkConcurrent(mode);
+
+	// What the line changed, marked in the shared region once per brick and once for the box
+	glm::ivec3 low(INT_MAX), high(INT_MIN);
+	glm::ivec3 lastBrick(-1);
+
+	walkLine(p1, p2, vals, glm::ivec3(0), dims, [&](int x, int y, int z, float value, float /*weight*/) {
+		T& stored = cell(x, y, z);
+
+		if (mode == BLEND_MAX) {
+			brightenConcurrent(stored, value);
+		}
+		else {
+			asAtomic(stored).store(VoxelTraits<T>::fromFloat(value), std::memory_order_relaxed);
+		}
+
+		glm::ivec3 c(x, y, z);
+
+		if ((c >> BRICK_SHIFT) != lastBrick) {
+			dirty.markBrickConcurrent(x, y, z);
+			lastBrick = c >> BRICK_SHIFT;
+		}
+
+		low = glm::min(low, c);
+		high = glm::max(high, c + 1);
+	});
+
+	if (low.x < high.x) {
+		dirty.growBoxConcurrent(low, high);
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::addLineSmoothedConcurrent(glm::vec3 p1, glm::vec3 p2, SampleView vals, int radius) {
+	BlendMode mode = blendFor(BLEND_MAX);
+	checkConcurrent(mode);
+
+	// The stencils kept by the map are made the first time they are needed,
+	// which is not safe from several threads, so every call makes its own
+	SmoothingStencil stencil(radius);
+	const StencilEntry* entries = stencil.getEntries();
+	size_t entryCount = stencil.size();
+
+	glm::ivec3 low(INT_MAX), high(INT_MIN);
+
+	// Same samples as addSpheres(), and stamping a cell again changes nothing
+	forEachSampleCell(p1, p2, int(vals.size()), radius, true, [&](int x, int y, int z) {
+		// Clips the cube around (x, y, z) to the window
+		glm::ivec3 minCell = glm::max(glm::ivec3(x, y, z) - radius, glm::ivec3(0));
+		glm::ivec3 maxCell = glm::min(glm::ivec3(x, y, z) + radius, dims - 1);
+
+		if (glm::any(glm::greaterThan(minCell, maxCell))) {
+			return;
+		}
+
+		for (size_t k = 0; k < entryCount; k++) {
+			int px = x + entries[k].dx;
+			int py = y + entries[k].dy;
+			int pz = z + entries[k].dz;
+
+			if (px < minCell.x || px > maxCell.x || py < minCell.y || py > maxCell.y || pz < minCell.z || pz > maxCell.z) {
+				continue;
+			}
+
+			T& stored = cell(px, py, pz);
+
+			if (mode == BLEND_MAX) {
+				brightenConcurrent(stored, entries[k].weight);
+			}
+			else {
+				asAtomic(stored).store(VoxelTraits<T>::fromFloat(entries[k].weight), std::memory_order_relaxed);
+			}
+		}
+
+		// Every brick the cube touches
+		for (int bx = minCell.x >> BRICK_SHIFT; bx <= maxCell.x >> BRICK_SHIFT; bx++) {
+			for (int by = minCell.y >> BRICK_SHIFT; by <= maxCell.y >> BRICK_SHIFT; by++) {
+				for (int bz = minCell.z >> BRICK_SHIFT; bz <= maxCell.z >> BRICK_SHIFT; bz++) {
+					dirty.markBrickConcurrent(bx << BRICK_SHIFT, by << BRICK_SHIFT, bz << BRICK_SHIFT);
+				}
+			}
+		}
+
+		low = glm::min(low, minCell);
+		high = glm::max(high, maxCell + 1);
+	});
 
-		// Move x, y, and z along the line
-		x += dx;
-		y += dy;
-		z += dz;
+	if (low.x < high.x) {
+		dirty.growBoxConcurrent(low, high);
 	}
 }
 
-void DensityMap::addLine(glm::vec3 p1, glm::vec3 p2, std::vector<float> vals) {
-	int numVals = vals.size();
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::setBlendMode(BlendMode mode, float alpha) {
+	resolve();
+
+	blendMode = mode;
+
+	if (blendAccumulates(mode)) {
+		accumulator.enable(dims, mode, alpha);
+	}
+	else {
+		accumulator.disable();
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::resolve(ThreadPool& pool) {
+	if (!accumulator.isEnabled()) {
+		return;
+	}
+
+	std::vector<size_t> bricks = accumulator.takeTouchedBricks();
+	int brickCount = int(bricks.size());
+
+	// Writes every cell of one stored brick that has values,
+	// marking it (at its place in the window) in marked
+	auto resolveBrick = [&](int b, DirtyRegion& marked) {
+		glm::ivec3 first = accumulator.brickOrigin(bricks[b]);
+		glm::ivec3 last = glm::min(first + BRICK_SIZE, dims);
+
+		for (int x = first.x; x < last.x; x++) {
+			for (int y = first.y; y < last.y; y++) {
+				for (int z = first.z; z < last.z; z++) {
+					float value;
+					if (!accumulator.resolve(x, y, z, value)) {
+						continue;
+					}
+
+					T& stored = cells(x, y, z);
+					float old = VoxelTraits<T>::toFloat(stored);
+					stored = VoxelTraits<T>::fromFloat(value);
+
+					glm::ivec3 window = storedToWindow(glm::ivec3(x, y, z));
+					marked.markCell(window.x, window.y, window.z);
+
+					if (mips.isEnabled()) {
+						mips.update(*this, window.x, window.y, window.z, old, VoxelTraits<T>::toFloat(stored));
+					}
+				}
+			}
+		}
+	};
+
+	if (writesSequentially(pool.getThreadCount())) {
+		for (int b = 0; b < brickCount; b++) {
+			resolveBrick(b, dirty);
+		}
+
+		return;
+	}
 
-	// x, y, and z coordinates of the current data point
-	// Moves along the line defined by p1 and p2
-	float x = p1.x;
-	float y = p1.y;
-	float z = p1.z;
+	// The accumulator and the storage share the same bricks,
+	// so one cell per brick gives it its memory
+	preallocateBricks(false, [&](auto prepare) {
+		for (int b = 0; b < brickCount; b++) {
+			glm::ivec3 first = accumulator.brickOrigin(bricks[b]);
+			prepare(first.x, first.y, first.z);
+		}
+	});
+
+	std::vector<DirtyRegion> threadDirty(pool.getThreadCount(), DirtyRegion(dims));
 
-	// Direction of the line defined by p1 and p2
-	float dx = (p2.x - p1.x) / numVals;
-	float dy = (p2.y - p1.y) / numVals;
-	float dz = (p2.z - p1.z) / numVals;
+	pool.parallelFor(brickCount, [&](int b, int thread) {
+		resolveBrick(b, threadDirty[thread]);
+	});
 
-	for (int i = 0; i < numVals; i++) {
-		// Cell index determined by x, y, and z
-		int ix = x * dim;
-		int iy = y * dim;
-		int iz = z * dim;
+	for (size_t i = 0; i < threadDirty.size(); i++) {
+		dirty.merge(threadDirty[i]);
+	}
+}
 
-		// Put the value in the array
-		cells[ix][iy][iz] = vals[i];
+template<typename T, template<typename> class Storage>
+size_t BasicDensityMap<T, Storage>::getMemoryUsage() const {
+	size_t bytes = cells.memoryUsage() + accumulator.memoryUsage();
 
-		// Move x, y, and z along the line
-		x += dx;
-		y += dy;
-		z += dz;
+	for (size_t i = 0; i < partials.size(); i++) {
+		bytes += partials[i].memoryUsage();
 	}
+
+	return bytes;
 }
 
 // Returns the vertices in a form useful to OpenGL
-std::vector<float> DensityMap::getVertices() {
+template<typename T, template<typename> class Storage>
+std::vector<float> BasicDensityMap<T, Storage>::getVertices() {
 	std::vector<float> vertices;
 
-	for (int i = 0; i < dim - 1; i++) {
-		for (int j = 0; j < dim - 1; j++) {
-			for (int k = 0; k < dim; k++) {
+	// 6 vertices per face, 3 floats per vertex
+	vertices.reserve(faceCount() * 6 * 3);
+
+	for (int i = 0; i < dims.x - 1; i++) {
+		for (int j = 0; j < dims.y - 1; j++) {
+			for (int k = 0; k < dims.z; k++) {
 				float v1[3] = { i, j, k };
 				float v2[3] = { i + 1, j, k };
 				float v3[3] = { i, j + 1, k };
@@ -151,9 +1542,9 @@ std::vector<float> DensityMap::getVertices() {
 		}
 	}
 
-	for (int i = 0; i < dim - 1; i++) {
-		for (int j = 0; j < dim; j++) {
-			for (int k = 0; k < dim - 1; k++) {
+	for (int i = 0; i < dims.x - 1; i++) {
+		for (int j = 0; j < dims.y; j++) {
+			for (int k = 0; k < dims.z - 1; k++) {
 				float v1[3] = { i,j, k };
 				float v2[3] = { i + 1, j, k };
 				float v3[3] = { i, j, k + 1 };
@@ -170,9 +1561,9 @@ std::vector<float> DensityMap::getVertices() {
 		}
 	}
 
-	for (int i = 0; i < dim; i++) {
-		for (int j = 0; j < dim - 1; j++) {
-			for (int k = 0; k < dim - 1; k++) {
+	for (int i = 0; i < dims.x; i++) {
+		for (int j = 0; j < dims.y - 1; j++) {
+			for (int k = 0; k < dims.z - 1; k++) {
 				float v1[3] = { i, j, k };
 				float v2[3] = { i, j + 1, k };
 				float v3[3] = { i, j, k + 1 };
@@ -192,77 +1583,222 @@ std::vector<float> DensityMap::getVertices() {
 	return vertices;
 }
 
+// Appends the two triangles of every face in one row of faces
+// -----
+// r1, r2, r3, and r4 are the rows holding the four corners
+// of each face, and every corner moves along its row at once,
+// so the loop only ever reads linear memory
+template<typename T>
+static void appendFaceRow(float* out, const T* r1, const T* r2, const T* r3, const T* r4, int count) {
+	for (int k = 0; k < count; k++) {
+		float d1 = VoxelTraits<T>::toFloat(r1[k]);
+		float d2 = VoxelTraits<T>::toFloat(r2[k]);
+		float d3 = VoxelTraits<T>::toFloat(r3[k]);
+		float d4 = VoxelTraits<T>::toFloat(r4[k]);
+
+		out[0] = d1;
+		out[1] = d2;
+		out[2] = d4;
+
+		out[3] = d1;
+		out[4] = d3;
+		out[5] = d4;
+
+		out += 6;
+	}
+}
+
 // Returns the cell densities
-std::vector<float> DensityMap::getDensities() {
-	std::vector<float> densities;
+template<typename T, template<typename> class Storage>
+std::vector<float> BasicDensityMap<T, Storage>::getDensities() {
+	// Same order as BasicDensityMap::getVertices()
+	std::vector<float> densities(faceCount() * 6);
+	float* out = densities.data();
 
-	for (int i = 0; i < dim - 1; i++) {
-		for (int j = 0; j < dim - 1; j++) {
-			for (int k = 0; k < dim; k++) {
-				float d1 = cells[i][j][k];
-				float d2 = cells[i + 1][j][k];
-				float d3 = cells[i][j + 1][k];
-				float d4 = cells[i + 1][j + 1][k];
+	// The rows are read through the storage, which either
+	// points straight at them or copies them into the first four of these
+	// (the other four hold rows that wrap around once the window moved)
+	std::vector<T> scratch(size_t(8) * dims.z);
+	T* s1 = scratch.data();
+	T* s2 = s1 + dims.z;
+	T* s3 = s2 + dims.z;
+	T* s4 = s3 + dims.z;
+	T* w1 = s4 + dims.z;
+	T* w2 = w1 + dims.z;
+	T* w3 = w2 + dims.z;
+	T* w4 = w3 + dims.z;
 
-				densities.push_back(d1);
-				densities.push_back(d2);
-				densities.push_back(d4);
+	for (int i = 0; i < dims.x - 1; i++) {
+		for (int j = 0; j < dims.y - 1; j++) {
+			const T* r1 = readRow(i, j, s1, w1);
+			const T* r2 = readRow(i + 1, j, s2, w2);
+			const T* r3 = readRow(i, j + 1, s3, w3);
+			const T* r4 = readRow(i + 1, j + 1, s4, w4);
 
-				densities.push_back(d1);
-				densities.push_back(d3);
-				densities.push_back(d4);
-			}
+			appendFaceRow(out, r1, r2, r3, r4, dims.z);
+			out += dims.z * 6;
 		}
 	}
 
-	for (int i = 0; i < dim - 1; i++) {
-		for (int j = 0; j < dim; j++) {
-			for (int k = 0; k < dim - 1; k++) {
-				float d1 = cells[i][j][k];
-				float d2 = cells[i + 1][j][k];
-				float d3 = cells[i][j][k + 1];
-				float d4 = cells[i + 1][j][k + 1];
+	for (int i = 0; i < dims.x - 1; i++) {
+		for (int j = 0; j < dims.y; j++) {
+			// The face corners are (k, k + 1) along the same row
+			const T* r1 = readRow(i, j, s1, w1);
+			const T* r2 = readRow(i + 1, j, s2, w2);
 
-				densities.push_back(d1);
-				densities.push_back(d2);
-				densities.push_back(d4);
+			appendFaceRow(out, r1, r2, r1 + 1, r2 + 1, dims.z - 1);
+			out += (dims.z - 1) * 6;
+		}
+	}
 
-				densities.push_back(d1);
-				densities.push_back(d3);
-				densities.push_back(d4);
-			}
+	for (int i = 0; i < dims.x; i++) {
+		for (int j = 0; j < dims.y - 1; j++) {
+			const T* r1 = readRow(i, j, s1, w1);
+			const T* r2 = readRow(i, j + 1, s2, w2);
+
+			appendFaceRow(out, r1, r2, r1 + 1, r2 + 1, dims.z - 1);
+			out += (dims.z - 1) * 6;
 		}
 	}
 
-	for (int i = 0; i < dim; i++) {
-		for (int j = 0; j < dim - 1; j++) {
-			for (int k = 0; k < dim - 1; k++) {
-				float d1 = cells[i][j][k];
-				float d2 = cells[i][j + 1][k];
-				float d3 = cells[i][j][k + 1];
-				float d4 = cells[i][j + 1][k + 1];
+	return densities;
+}
+
+template<typename T, template<typename> class Storage>
+const T* BasicDensityMap<T, Storage>::readRow(int x, int y, T* scratch, T* rotated) const {
+	const T* row = cells.readRow(wrapX(x), wrapY(y), scratch);
+
+	if (offset.z == 0) {
+		return row;
+	}
+
+	// The window row starts offset.z cells into the stored row,
+	// so the two parts of the stored row swap places
+	std::copy(row + offset.z, row + dims.z, rotated);
+	std::copy(row, row + offset.z, rotated + (dims.z - offset.z));
+
+	return rotated;
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::clearSlabs(int axis, int begin, int count) {
+	// Splits the range where it wraps around the end
+	int end = std::min(begin + count, dims[axis]);
+	int wrapped = begin + count - end;
+
+	glm::ivec3 min(0), max = dims;
+	min[axis] = begin;
+	max[axis] = end;
+	cells.clearBox(min.x, min.y, min.z, max.x, max.y, max.z);
+	accumulator.clearBox(min.x, min.y, min.z, max.x, max.y, max.z);
+
+	if (wrapped > 0) {
+		min[axis] = 0;
+		max[axis] = wrapped;
+		cells.clearBox(min.x, min.y, min.z, max.x, max.y, max.z);
+		accumulator.clearBox(min.x, min.y, min.z, max.x, max.y, max.z);
+	}
+}
+
+template<typename T, template<typename> class Storage>
+void BasicDensityMap<T, Storage>::setOrigin(glm::ivec3 origin) {
+	glm::ivec3 shift = origin - this->origin;
+
+	if (shift == glm::ivec3(0)) {
+		return;
+	}
 
-				densities.push_back(d1);
-				densities.push_back(d2);
-				densities.push_back(d4);
+	if (glm::any(glm::greaterThanEqual(glm::abs(shift), dims))) {
+		// Nothing stays inside the window
+		cells.clear();
+		accumulator.clear();
+	}
+	else {
+		// A stored slab holds the same window slab until the window moves,
+		// and then holds whatever world slab wraps onto it, so the slabs that
+		// left the window along any axis are exactly the ones to zero
+		for (int axis = 0; axis < 3; axis++) {
+			int count = std::abs(shift[axis]);
 
-				densities.push_back(d1);
-				densities.push_back(d3);
-				densities.push_back(d4);
+			if (count == 0) {
+				continue;
 			}
+
+			// Moving up recycles the slabs at the bottom of the window,
+			// and moving down the ones at the top
+			int first = shift[axis] > 0 ? 0 : dims[axis] - count;
+			int begin = (offset[axis] + first) % dims[axis];
+
+			clearSlabs(axis, begin, count);
 		}
 	}
 
-	return densities;
+	this->origin = origin;
+
+	// Positive remainder, so windows left of the world origin work too
+	offset = ((origin % dims) + dims) % dims;
+
+	dirty.markAll();
+
+	if (mips.isEnabled()) {
+		mips.rebuild(*this);
+	}
+}
+
+template<typename T, template<typename> class Storage>
+bool BasicDensityMap<T, Storage>::follow(glm::vec3 point, int margin) {
+	glm::ivec3 local = glm::ivec3(glm::floor(point * scale)) - origin;
+	glm::ivec3 target = origin;
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (local[axis] < margin || local[axis] >= dims[axis] - margin) {
+			target[axis] = origin[axis] + local[axis] - dims[axis] / 2;
+		}
+	}
+
+	if (target == origin) {
+		return false;
+	}
+
+	setOrigin(target);
+	return true;
+}
+
+// Returns the number of faces drawn by getVertices()
+template<typename T, template<typename> class Storage>
+size_t BasicDensityMap<T, Storage>::faceCount() const {
+	size_t x = dims.x, y = dims.y, z = dims.z;
+
+	return (x - 1) * (y - 1) * z + (x - 1) * y * (z - 1) + x * (y - 1) * (z - 1);
 }
 
-// Returns dim
-int DensityMap::getDim() {
-	return dim;
+// Returns the number of cells along x
+template<typename T, template<typename> class Storage>
+int BasicDensityMap<T, Storage>::getDim() {
+	return dims.x;
 }
 
-// Not being used right now, but maybe in the future
-// to get smoother shading
+template class BasicDensityMap<float, VoxelBuffer>;
+template class BasicDensityMap<uint8_t, VoxelBuffer>;
+template class BasicDensityMap<uint16_t, VoxelBuffer>;
+template class BasicDensityMap<Half, VoxelBuffer>;
+
+template class BasicDensityMap<float, BrickBuffer>;
+template class BasicDensityMap<uint8_t, BrickBuffer>;
+template class BasicDensityMap<uint16_t, BrickBuffer>;
+template class BasicDensityMap<Half, BrickBuffer>;
+
+template class BasicDensityMap<float, SparseBuffer>;
+template class BasicDensityMap<uint8_t, SparseBuffer>;
+template class BasicDensityMap<uint16_t, SparseBuffer>;
+template class BasicDensityMap<Half, SparseBuffer>;
+
+template class BasicDensityMap<float, MappedBuffer>;
+template class BasicDensityMap<uint8_t, MappedBuffer>;
+template class BasicDensityMap<uint16_t, MappedBuffer>;
+template class BasicDensityMap<Half, MappedBuffer>;
+
+// Returns the distance from v to the segment from a to b
 float pointLineDistance(glm::vec3 a, glm::vec3 b, glm::vec3 v) {
 	glm::vec3 ab = b - a;
 	glm::vec3 av = v - a;
@@ -1,40 +1,516 @@
 #pragma once
 
+#include <utility>
 #include <vector>
 
 #include <glm/glm.hpp>
 
+#include "accumulator.h"
+#include "brickBuffer.h"
+#include "dirtyRegion.h"
+#include "frameGeometry.h"
+#include "mappedBuffer.h"
+#include "mipPyramid.h"
+#include "partialVolume.h"
+#include "sampleView.h"
+#include "smoothingStencil.h"
+#include "sparseBuffer.h"
+#include "threadPool.h"
+#include "voxelBuffer.h"
+#include "voxelTypes.h"
+
+// What addLineSmoothed() brightens around a line
+enum SmoothingShape {
+	SMOOTH_SPHERES, // a sphere around every value (cost grows with the number of values)
+	SMOOTH_CAPSULE  // the capsule around the whole segment, once (cost grows with its volume)
+};
+
+// How addLine() and the functions built on it work out the value of a cell
+// when the line has fewer samples than cells
+enum SampleInterpolation {
+	INTERPOLATE_NEAREST,    // the sample covering the middle of the cell (steps when samples are sparse)
+	INTERPOLATE_LINEAR,     // a straight line between the samples on either side
+	INTERPOLATE_CATMULL_ROM // a Catmull-Rom spline through the four samples around the cell (kept within them)
+};
+
+// Number of cells addLine() interpolates the values of at once
+// Everything but reading the samples is the same for the whole batch, so it vectorizes
+#define WALK_BATCH 16
+
+// Number of samples addLineSplatted() works out the weights of at once
+// Every step of the weights is the same for the whole batch,
+// so the compiler turns each one into a few vector instructions
+#define SPLAT_BATCH 8
+
+// Number of samples addLineSmoothed() works out the cells of at once
+// The positions are stepped in 16.16 fixed point, so every lane is one add and one shift
+#define STEP_BATCH 16
+
+// Number of samples addFrame() moves to the window at once
+#define FRAME_BATCH 64
+
+// One line of data for BasicDensityMap::addLines()
+// Same as the arguments of BasicDensityMap::addLine()
+// vals only points at the samples (see SampleView), so the caller
+// keeps them alive until addLines() returns
+struct ScanLine {
+	glm::vec3 p1;
+	glm::vec3 p2;
+	SampleView vals;
+};
+
 // Class that stores the density readings
 // and other related info
-class DensityMap {
+// -----
+// T is the type each cell is stored as (see voxelTypes.h).
+// Every function still takes and returns floats between 0 and 1,
+// and writes are saturated to whatever T can hold.
+// -----
+// Storage decides how the cells are laid out in memory:
+// VoxelBuffer stores them row by row, BrickBuffer stores them
+// as 8x8x8 bricks along a Z-order curve, SparseBuffer only
+// stores the 8x8x8 bricks that were written, and MappedBuffer stores
+// them row by row in a memory-mapped file.
+// Every storage has the same accessor interface, which is all
+// the rest of the class uses, so nothing else depends on the layout:
+//   Storage(int dimX, int dimY, int dimZ)   zero-filled cells
+//   T& operator()(int x, int y, int z)      access to one cell for writing
+//   const T& operator()(...) const          access to one cell for reading
+//   const T* readRow(int x, int y, T* scratch)
+//                                           the cells along z at (x, y),
+//                                           copied into scratch if needed
+//   void clear()                            fills every cell with zero
+//   void clearBox(minX, minY, minZ, maxX, maxY, maxZ)
+//                                           fills the cells in a box with zero
+//   Span<T> span()                          the raw memory, if there is one block
+//   size_t memoryUsage()                    bytes used by the cells
+// -----
+// The map is a window onto an unbounded grid of cells in world space.
+// Points are in world units, and the window starts at the cell getOrigin().
+// setOrigin() and follow() slide the window, and the cells are stored
+// toroidally, so a slide only zeroes the slabs that left the window
+// and everything else stays where it is in memory.
+// Cell coordinates (get(), set(), getDirty(), ...) are always relative to the window.
+// -----
+// Instantiated in densityMap.cpp for float, uint8_t, uint16_t, and Half
+// with every storage
+template<typename T, template<typename> class Storage = VoxelBuffer>
+class BasicDensityMap {
 private:
-	// This should never change after initialization
-	int dim;
+	// Number of cells along x, y, and z
+	// These should never change after initialization
+	glm::ivec3 dims;
+
+	// Size of one cell along x, y, and z
+	// in the same units as the points passed to addLine()
+	glm::vec3 spacing;
+
+	// Cells per unit along x, y, and z (1 / spacing)
+	// Stored separately so a cubic map keeps exact integer scales
+	glm::vec3 scale;
+
+	// World cell at (0, 0, 0) of the window, see setOrigin()
+	glm::ivec3 origin;
+
+	// Where (0, 0, 0) of the window is stored in cells
+	// (origin wrapped into the dimensions)
+	glm::ivec3 offset;
+
+	// Positions in cells of the window cell x, y, or z
+	// x must be between 0 and dims.x - 1 (and so on)
+	int wrapX(int x) const { x += offset.x; return x >= dims.x ? x - dims.x : x; }
+	int wrapY(int y) const { y += offset.y; return y >= dims.y ? y - dims.y : y; }
+	int wrapZ(int z) const { z += offset.z; return z >= dims.z ? z - dims.z : z; }
+
+	// Window cell of the cell at stored (the other way around)
+	glm::ivec3 storedToWindow(glm::ivec3 stored) const {
+		return glm::ivec3(
+			stored.x >= offset.x ? stored.x - offset.x : stored.x - offset.x + dims.x,
+			stored.y >= offset.y ? stored.y - offset.y : stored.y - offset.y + dims.y,
+			stored.z >= offset.z ? stored.z - offset.z : stored.z - offset.z + dims.z);
+	}
+
+	// The stored cell at (x, y, z) of the window
+	T& cell(int x, int y, int z) { return cells(wrapX(x), wrapY(y), wrapZ(z)); }
+	const T& cell(int x, int y, int z) const { return cells(wrapX(x), wrapY(y), wrapZ(z)); }
+
+	// Reads the window row at (x, y) in window order
+	// scratch and rotated must each hold dims.z cells
+	const T* readRow(int x, int y, T* scratch, T* rotated) const;
+
+	// Stencils addLineSmoothed() has used so far, one per radius
+	std::vector<SmoothingStencil> stencils;
+
+	// Returns the stencil for radius, making it the first time
+	const SmoothingStencil& getStencil(int radius);
+
+	// Brightens the sphere of stencil around the window cell (x, y, z)
+	void stamp(const SmoothingStencil& stencil, int x, int y, int z, BlendMode mode);
+
+	// Brightens the sphere around every sample of addLineSmoothed(),
+	// with stampFixed<R>() where it can and stamp() everywhere else
+	// (R = 0 means there is no fixed kernel for the radius)
+	template<int R>
+	void addSpheres(glm::vec3 p1, glm::vec3 p2, int numVals, const SmoothingStencil& stencil, BlendMode mode);
+
+	// Brightens the sphere of FixedStencil<R> around the window cell (x, y, z)
+	// rowStride and sliceStride are the strides of the storage
+	// Returns false, without touching anything, where only stamp() can do it
+	template<int R>
+	bool stampFixed(int x, int y, int z, size_t rowStride, size_t sliceStride);
+
+	// Brightens every cell within radius of the segment from a to b
+	// a and b are in window cells, with cell centres on whole numbers
+	void stampCapsule(glm::vec3 a, glm::vec3 b, int radius, BlendMode mode);
+
+	// Raises the stored cell at (x, y, z) of the window to value,
+	// unless it is already brighter
+	void brighten(T& stored, float value, int x, int y, int z) {
+		float old = VoxelTraits<T>::toFloat(stored);
+
+		if (old < value) {
+			stored = VoxelTraits<T>::fromFloat(value);
+
+			if (mips.isEnabled()) {
+				mips.update(*this, x, y, z, old, VoxelTraits<T>::toFloat(stored));
+			}
+		}
+	}
+
+	// How every write is combined with the cell, see setBlendMode()
+	BlendMode blendMode;
+
+	// Sums behind the averaging blend modes, empty for the others
+	Accumulator accumulator;
+
+	// How walkLine() works out the values, see setInterpolation()
+	SampleInterpolation interpolation;
+
+	// The blend mode a function that always used native uses now
+	BlendMode blendFor(BlendMode native) const { return blendMode == BLEND_DEFAULT ? native : blendMode; }
+
+	// Brings value into the window cell (x, y, z) under mode,
+	// marking the cell in marked if it changed
+	// weight only counts for BLEND_WEIGHTED_MEAN
+	// -----
+	// The averaging modes only add to the accumulator,
+	// and the cell changes (and is marked) in resolve()
+	void blend(BlendMode mode, int x, int y, int z, float value, float weight, DirtyRegion& marked) {
+		switch (mode) {
+		case BLEND_LATEST: {
+			T& stored = cell(x, y, z);
+			float old = VoxelTraits<T>::toFloat(stored);
+
+			stored = VoxelTraits<T>::fromFloat(value);
+			marked.markCell(x, y, z);
+
+			if (mips.isEnabled()) {
+				mips.update(*this, x, y, z, old, VoxelTraits<T>::toFloat(stored));
+			}
+			break;
+		}
+		case BLEND_MAX:
+			brighten(cell(x, y, z), value, x, y, z);
+			marked.markCell(x, y, z);
+			break;
+		default:
+			accumulator.add(wrapX(x), wrapY(y), wrapZ(z), value, weight);
+			break;
+		}
+	}
+
+	// Calls visit(x, y, z, value, weight) for every window cell the line from p1 to p2
+	// passes through inside the box from boxMin (inclusive) to boxMax (exclusive),
+	// in order along the line, with the value addLine() gives the cell
+	// and the length of the line inside the cell (in cells) as its weight
+	// -----
+	// Unless interpolation is INTERPOLATE_NEAREST, the cells are queued WALK_BATCH at a time
+	// and their values interpolated together before they are visited
+	template<typename Visit>
+	void walkLine(glm::vec3 p1, glm::vec3 p2, SampleView vals, glm::ivec3 boxMin, glm::ivec3 boxMax, Visit visit) const;
+
+	// Calls visit(x, y, z) with the window cell of every sample of a line of count samples
+	// from p1 to p2 (sample i at p1 + i * (p2 - p1) / count), in order along the line
+	// -----
+	// Samples more than margin cells outside the window are left out,
+	// and with skipRepeats so is every sample in the same cell as the one before it
+	// (for writes that change nothing the second time).
+	// The cells are worked out STEP_BATCH at a time from positions in 16.16 fixed point,
+	// anchored again at the start of every batch, so they do not drift however long the line is.
+	// Windows must be less than 32768 - margin cells along every axis
+	template<typename Visit>
+	void forEachSampleCell(glm::vec3 p1, glm::vec3 p2, int count, int margin, bool skipRepeats, Visit visit) const;
+
+	// Probe space positions of the last geometry addFrame() was given
+	FrameLut frameLut;
+
+	// addFrame() with RECONSTRUCT_BACKWARD, for the geometry in frameLut
+	void addFrameBackward(const glm::mat4& pose, SampleView samples, ThreadPool& pool);
+
+	// Calls writeRange(minX, maxX, marked) for every range of window x
+	// that a stored slab 8 cells (one brick) thick covers, one slab per task of pool,
+	// with a DirtyRegion of the thread to mark the cells it writes in,
+	// and then merges every thread's region into dirty
+	// -----
+	// No two slabs share a brick of the storage, even once the window moved,
+	// so the ranges can be written at the same time
+	template<typename WriteRange>
+	void forEachSlab(ThreadPool& pool, WriteRange writeRange);
+
+	// Throws std::logic_error unless the concurrent functions can write under mode
+	// (see addLineConcurrent())
+	void checkConcurrent(BlendMode mode) const;
+
+	// One cell written by addLines()
+	struct CellWrite {
+		int x;
+		int y;
+		int z;
+		float value;
+		float weight;
+	};
+
+	// Cells every line of the last addLines() call writes, in order along the line
+	// Kept between calls so the memory is reused
+	std::vector<std::vector<CellWrite>> lineWrites;
+
+	// Returns true if the parallel functions have to write the cells one at a time
+	// on the calling thread: with a single thread, or with mips, since every mip cell
+	// sits above cells from several slabs and bricks
+	bool writesSequentially(int threadCount) const { return mips.isEnabled() || threadCount == 1; }
+
+	// Gives every brick several threads are about to write its memory up front,
+	// for the storages that hand out bricks on the first write,
+	// or in the accumulator if averages (the averaging modes write there instead)
+	// forEachCell(prepare) calls prepare(x, y, z) for the stored cells about to be written,
+	// and a run of cells in the same brick only gives out the brick once
+	template<typename ForEachCell>
+	void preallocateBricks(bool averages, ForEachCell forEachCell);
+
+	// One volume per thread for addLinesCompounded()
+	// Kept between calls so the bricks are reused
+	std::vector<PartialVolume> partials;
+
+	// Zeroes count stored slabs along axis (0 is x, 1 is y, 2 is z)
+	// starting at the stored slab begin, wrapping around the end
+	// (the sums of the accumulator too)
+	void clearSlabs(int axis, int begin, int count);
+
+	// Number of faces drawn by getVertices()
+	size_t faceCount() const;
+
+	// Sets up everything except the cells
+	// Called by every constructor
+	void init(glm::ivec3 dims, glm::vec3 spacing, glm::vec3 scale);
 
 public:
 	// 3D array that stores the data
-	std::vector<std::vector<std::vector<float>>> cells;
+	// in one contiguous, aligned block
+	Storage<T> cells;
+
+	// Which cells changed since the last resetDirty()
+	// Every function that writes cells marks them here
+	DirtyRegion dirty;
+
+	// Coarser copies of the map, empty unless enableMips() was called
+	// Every function that writes cells updates them
+	MipPyramid mips;
 
 	// Constructor
-	DensityMap(int dim);
+	// Makes a cube with dim cells along each axis
+	// that covers points between 0 and 1 (until it is moved)
+	BasicDensityMap(int dim);
+
+	// Constructor
+	// Makes a box with dims.x * dims.y * dims.z cells
+	// where each cell is spacing.x * spacing.y * spacing.z units large,
+	// so it covers points between 0 and dims * spacing (until it is moved)
+	BasicDensityMap(glm::ivec3 dims, glm::vec3 spacing);
+
+	// Constructor
+	// Same as above, but everything after spacing
+	// is passed on to the constructor of the storage,
+	// like the file name of a MappedBuffer
+	template<typename... StorageArgs>
+	BasicDensityMap(glm::ivec3 dims, glm::vec3 spacing, StorageArgs&&... storageArgs)
+		: cells(dims.x, dims.y, dims.z, std::forward<StorageArgs>(storageArgs)...), dirty(dims) {
+		init(dims, spacing, 1.0f / spacing);
+	}
 
 	// Adds a line of data between p1 and p2
+	// Samples outside the window are dropped
 	// The area around the line is faded
 	// -----
+	// Under BLEND_DEFAULT every cell keeps the brightest value it was given.
+	// The other blend modes blend the brightness instead (see setBlendMode()),
+	// and BLEND_WEIGHTED_MEAN weighs it by itself, so cells close to the line count more.
+	// -----
+	// With SMOOTH_SPHERES, the sphere around each sample comes from
+	// a SmoothingStencil made once per radius, so every sample is a walk over a table.
+	// The cells of the samples come from forEachSampleCell(), and under BLEND_DEFAULT,
+	// BLEND_MAX, and BLEND_LATEST a sample in the same cell as the one before it is skipped.
+	// Radii 1 to 8 have a kernel of their own for VoxelBuffer and MappedBuffer
+	// (see FixedStencil), which is used while mips are off.
+	// With SMOOTH_CAPSULE, every cell within radius of the segment is brightened once
+	// by its distance to the segment, however many values there are.
+	// -----
 	// I do not recommend using this if you have a lot of data
 	// because the result will look blurry
 	// (like with ultrasound data !!!)
-	void addLineSmoothed(glm::vec3 p1, glm::vec3 p2, std::vector<float> vals, int radius = 5);
+	void addLineSmoothed(glm::vec3 p1, glm::vec3 p2, SampleView vals, int radius = 5, SmoothingShape shape = SMOOTH_SPHERES);
 
 	// Adds a line of data between p1 and p2
 	// The line is not smoothed with the surrounding area
 	// -----
+	// The line is clipped to the window and then walked cell by cell,
+	// so every cell it passes through is written exactly once,
+	// with the value at the middle of that cell's part of the line
+	// (the nearest sample, or one interpolated between samples, see setInterpolation()).
+	// The cells are written straight away: holding the writes back in bins
+	// to write every brick in one go was tried, and was slower on every storage,
+	// since the walk already goes through the cells of a line in order
+	// and few writes of a sweep land on the same cell twice.
+	// -----
+	// Under BLEND_DEFAULT the sample replaces the cell.
+	// BLEND_WEIGHTED_MEAN weighs every sample by the length of line inside the cell,
+	// so a line that only clips a corner counts for little.
+	// -----
+	// vals is a SampleView, so the samples can be a std::vector<float>,
+	// or a Span of floats, 8-bit, or 16-bit samples (with a lookup table)
+	// straight from where the probe put them, and nothing is copied.
+	// The same goes for every other function that takes samples.
+	// -----
 	// I recommend using this if you have a lot of data
-	// because if you use DensityMap::addLineSmoothed()
+	// because if you use BasicDensityMap::addLineSmoothed()
 	// then the result will look blurry
-	void addLine(glm::vec3 p1, glm::vec3 p2, std::vector<float> vals);
+	void addLine(glm::vec3 p1, glm::vec3 p2, SampleView vals);
+
+	// Adds a line of data between p1 and p2
+	// Every sample is spread over the 8 cells around it
+	// -----
+	// Sample i sits in the middle of its stretch of the line,
+	// and each of the 8 cells whose centres surround it gets it
+	// with its trilinear weight, so there are no holes or stairs
+	// whether the samples are closer or further apart than the cells.
+	// Under BLEND_DEFAULT this uses the weighted mean, so every cell ends up with
+	// the weighted average of the samples around it once resolve() is called.
+	// The other modes get the sample in every cell with a weight above zero.
+	// -----
+	// The positions and weights are worked out SPLAT_BATCH samples at a time
+	void addLineSplatted(glm::vec3 p1, glm::vec3 p2, SampleView vals);
+
+	// Adds one frame of a sector probe
+	// pose takes probe space (see FrameGeometry) to world space,
+	// and samples holds geometry.lines * geometry.samplesPerLine values, line after line
+	// -----
+	// With RECONSTRUCT_FORWARD, the probe space position of every sample is worked out
+	// once per geometry and kept, so a frame is one pass over that table: FRAME_BATCH
+	// positions at a time are moved straight into window cells by a single matrix
+	// (pose, scale, and window combined), and every sample is written to the cell it lands in
+	// like addLine() would (a weight of 1 for BLEND_WEIGHTED_MEAN).
+	// Samples outside the window are dropped.
+	// -----
+	// With RECONSTRUCT_BACKWARD, it goes the other way: every cell the plane of the frame
+	// passes through is moved into probe space, and if it is inside the fan it gets
+	// the samples around it interpolated bilinearly (along the arc and along the depth).
+	// Rows of cells are cut down to the part that crosses the plane before they are walked,
+	// so the cost grows with the cells the frame covers, and every one of them is written,
+	// so there are no holes however far apart the lines are.
+	// Each cell is written by a single thread of pool (split into slabs like addLines()),
+	// or all on the calling thread with mips enabled.
+	// -----
+	// Throws std::invalid_argument if there are fewer samples than the geometry needs
+	void addFrame(const glm::mat4& pose, const FrameGeometry& geometry, SampleView samples,
+		ReconstructionMode reconstruction = RECONSTRUCT_FORWARD, ThreadPool& pool = ThreadPool::shared());
+
+	// Adds every line in lines, using every thread of pool
+	// -----
+	// The result is exactly the same as calling addLine() on the lines in order.
+	// Every line is first walked on its own (in parallel),
+	// and then the window is split into slabs 8 cells thick along x
+	// and each slab is written by one thread, going through the lines in order,
+	// so no two threads ever write the same cell.
+	// -----
+	// With mips enabled, the lines are added one at a time on the calling thread
+	void addLines(const std::vector<ScanLine>& lines, ThreadPool& pool = ThreadPool::shared());
+
+	// Adds every line in lines, using every thread of pool, where they cross a lot
+	// -----
+	// Every thread adds its share of the lines to a sparse PartialVolume of its own,
+	// so threads never write the same memory however many lines pass through
+	// the same cells (like the apex of a fan), and there are no locks or atomics.
+	// The volumes are then merged into the map in parallel, one brick per task:
+	// BLEND_MAX (and BLEND_DEFAULT) keeps the brightest value of every volume,
+	// and BLEND_MEAN and BLEND_WEIGHTED_MEAN add up their sums and weights
+	// (use resolve() afterwards as usual, see setBlendMode()).
+	// The result does not depend on which thread got which line.
+	// The volumes are kept for the next call, so they only allocate while they grow.
+	// -----
+	// BLEND_LATEST and BLEND_EMA depend on the order of the lines, so they go through addLines().
+	// With mips enabled, the lines are still added in parallel and the merge is done on the calling thread.
+	void addLinesCompounded(const std::vector<ScanLine>& lines, ThreadPool& pool = ThreadPool::shared());
+
+	// Same as addLine(), but safe to call from several threads at once on the same map
+	// -----
+	// Every cell is written with a relaxed atomic store (or, under BLEND_MAX,
+	// raised with an atomic compare-and-swap), and the changes are marked with atomic ors,
+	// so the threads never wait for a lock. Where lines from two threads cross,
+	// the cell ends up like the lines were added in either order.
+	// -----
+	// Only VoxelBuffer and MappedBuffer keep every cell in place while it is written
+	// (BrickBuffer and SparseBuffer wipe or hand out bricks on the first write),
+	// and the averaging blend modes share their sums, so anything else throws std::logic_error.
+	// The mip levels are not updated (call rebuildMips() once every thread is done),
+	// and only the concurrent functions may use the map until then.
+	void addLineConcurrent(glm::vec3 p1, glm::vec3 p2, SampleView vals);
+
+	// Same as addLineSmoothed() with SMOOTH_SPHERES, but safe to call from several threads
+	// at once on the same map, like addLineConcurrent()
+	// -----
+	// The "never darken a cell" rule is an atomic compare-and-swap max,
+	// so the result is the same whatever order the lines come in.
+	void addLineSmoothedConcurrent(glm::vec3 p1, glm::vec3 p2, SampleView vals, int radius = 5);
+
+	// Chooses how new values are combined with what the cells hold
+	// alpha is how far BLEND_EMA moves a cell towards every new value (0 to 1)
+	// -----
+	// BLEND_MEAN, BLEND_WEIGHTED_MEAN, and BLEND_EMA keep a running sum and weight
+	// for every cell in an Accumulator (only for the bricks that were written),
+	// and the cells only change in resolve(), so call it before reading them
+	// (once per frame is enough). Values already in the map are not part of the averages.
+	// Switching modes resolves whatever was pending and starts the averages over.
+	void setBlendMode(BlendMode mode, float alpha = 0.25f);
+
+	// Returns the mode chosen with setBlendMode()
+	BlendMode getBlendMode() const { return blendMode; }
+
+	// Chooses how addLine(), addLines(), addLinesCompounded(), and addLineConcurrent()
+	// work out the value of a cell from the samples around it
+	// -----
+	// A line with fewer samples than cells (a deep line in a fine map) gives runs of cells
+	// the same sample under INTERPOLATE_NEAREST, which shows up as steps along the line.
+	// INTERPOLATE_LINEAR and INTERPOLATE_CATMULL_ROM give every cell the value
+	// at its own place between the samples instead. They cost a little more per cell,
+	// and are worth it when there are fewer samples than cells.
+	void setInterpolation(SampleInterpolation interpolation) { this->interpolation = interpolation; }
+
+	// Returns the interpolation chosen with setInterpolation()
+	SampleInterpolation getInterpolation() const { return interpolation; }
+
+	// Writes the averages of every brick that got values since the last resolve()
+	// into the cells, using every thread of pool (this is also the normalization
+	// step of addLineSplatted())
+	// -----
+	// Only those bricks are visited, and each one by a single thread.
+	// The averages are kept, so later values keep averaging with earlier ones.
+	// With mips enabled, the bricks are written one at a time on the calling thread.
+	// Does nothing unless the blend mode averages or addLineSplatted() was used.
+	void resolve(ThreadPool& pool = ThreadPool::shared());
 
 	// Overwrites everything with zeroes
+	// -----
+	// With BrickBuffer and SparseBuffer this takes constant time,
+	// because bricks are only wiped when they are written again
 	void clear();
 
 	// Returns the vertices in a form useful to OpenGL
@@ -43,10 +519,149 @@ public:
 	// Returns the cell densities
 	std::vector<float> getDensities();
 
-	// Returns dim
+	// Returns the number of cells along x
+	// (which is the side length of a cubic map)
 	int getDim();
+
+	// Returns the number of cells along x, y, and z
+	glm::ivec3 getDims() const { return dims; }
+
+	// Returns the size of one cell along x, y, and z
+	glm::vec3 getSpacing() const { return spacing; }
+
+	// Returns the size of the whole map along x, y, and z
+	glm::vec3 getExtent() const { return glm::vec3(dims) * spacing; }
+
+	// Returns the world cell at (0, 0, 0) of the window
+	glm::ivec3 getOrigin() const { return origin; }
+
+	// Returns the world position of the corner of the window at (0, 0, 0)
+	// The window covers points from here to here + getExtent()
+	glm::vec3 getWindowMin() const { return glm::vec3(origin) / scale; }
+
+	// Slides the window so that it starts at the world cell origin
+	// -----
+	// Cells that stay inside the window keep their values,
+	// and cells that come into it start out as zero.
+	// Only the slabs that left the window are touched,
+	// so a slide costs as much as the slabs it recycles, and memory never grows.
+	// The whole window is marked as changed (every cell moved on screen)
+	// and the mip levels are rebuilt.
+	void setOrigin(glm::ivec3 origin);
+
+	// Slides the window to keep point at least margin cells away from its sides
+	// -----
+	// Along every axis where point is too close to a side (or outside),
+	// the window is centred on point, so it slides in large steps
+	// instead of by one slab at a time.
+	// Returns true if the window moved.
+	bool follow(glm::vec3 point, int margin);
+
+	// Returns the number of bytes used to store the cells
+	// (and the sums of the averaging blend modes, and the partial volumes of addLinesCompounded())
+	size_t getMemoryUsage() const;
+
+	// Returns the density at (x, y, z)
+	// There are no bounds checks
+	float get(int x, int y, int z) const { return VoxelTraits<T>::toFloat(cell(x, y, z)); }
+
+	// Sets the density at (x, y, z)
+	// The value is saturated to what T can hold
+	// There are no bounds checks
+	void set(int x, int y, int z, float value) {
+		T& stored = cell(x, y, z);
+		float old = VoxelTraits<T>::toFloat(stored);
+
+		stored = VoxelTraits<T>::fromFloat(value);
+		dirty.markCell(x, y, z);
+
+		if (mips.isEnabled()) {
+			mips.update(*this, x, y, z, old, VoxelTraits<T>::toFloat(stored));
+		}
+	}
+
+	// Returns the stored cell at (x, y, z)
+	// There are no bounds checks
+	// The cell is marked as changed, since it can be written through the reference,
+	// but the mip levels are not updated (call rebuildMips() after writing)
+	T& at(int x, int y, int z) {
+		dirty.markCell(x, y, z);
+		return cell(x, y, z);
+	}
+	const T& at(int x, int y, int z) const { return cell(x, y, z); }
+
+	// Returns where the cell at (x, y, z) of the window is stored
+	// (the same place until the window is moved)
+	glm::ivec3 getStoredCell(int x, int y, int z) const { return glm::ivec3(wrapX(x), wrapY(y), wrapZ(z)); }
+
+	// Returns every cell as one block of linear memory
+	// Use cells.index() on getStoredCell() to find a cell inside it
+	// (the order depends on Storage)
+	// Writes through this are not tracked, so call markDirty() after them
+	Span<T> data() { return cells.span(); }
+	Span<const T> data() const { return cells.span(); }
+
+	// Returns which cells changed since the last resetDirty()
+	const DirtyRegion& getDirty() const { return dirty; }
+
+	// Forgets every change, once they have been dealt with
+	void resetDirty() { dirty.reset(); }
+
+	// Marks the cells from min (inclusive) to max (exclusive) as changed
+	// Only needed after writing through data()
+	void markDirty(glm::ivec3 min, glm::ivec3 max) { dirty.markBox(min, max); }
+
+	// Starts keeping coarser copies of the map (see MipPyramid)
+	// levels is the number of levels above the map, and 0 means
+	// every level down to a single cell
+	// -----
+	// From then on every write updates only the mip cells above it,
+	// which costs about one cell per level
+	void enableMips(int levels = 0) {
+		mips.enable(dims, spacing, levels);
+		mips.rebuild(*this);
+	}
+
+	// Stops keeping the coarser copies and frees them
+	void disableMips() { mips.disable(); }
+
+	// Recomputes every mip level from the map
+	// Only needed after writing through at() or data()
+	void rebuildMips() { mips.rebuild(*this); }
+
+	// Returns the number of mip levels above the map
+	int getMipLevelCount() const { return mips.getLevelCount(); }
+
+	// Returns one mip level, 1 being the first level above the map
+	// Levels have the same read functions as the map (get(), getDims(), ...)
+	const MipLevel& getMipLevel(int level, MipReduction reduction) const { return mips.getLevel(level, reduction); }
 };
 
-// Not being used right now, but maybe in the future
-// to get smoother shading
+// The density map everything used before the cell type could be changed
+// Stores 32-bit floats
+typedef BasicDensityMap<float> DensityMap;
+
+// Smaller density maps for when memory or bandwidth matters more than precision
+// A 512^3 DensityMap8 is 128 MB where a DensityMap is 512 MB
+typedef BasicDensityMap<uint8_t> DensityMap8;
+typedef BasicDensityMap<uint16_t> DensityMap16;
+typedef BasicDensityMap<Half> DensityMapHalf;
+
+// Density map stored as 8x8x8 bricks, for code that mostly touches
+// small neighbourhoods (smoothing, filters) instead of whole rows
+typedef BasicDensityMap<float, BrickBuffer> BrickedDensityMap;
+
+// Density map that only stores the bricks that were written,
+// for sweeps that fill a small part of a large volume
+typedef BasicDensityMap<float, SparseBuffer> SparseDensityMap;
+
+// Density map that lives in a memory-mapped file,
+// for volumes that do not fit in RAM
+// Use cells.advise() and cells.flush() to control the paging
+typedef BasicDensityMap<float, MappedBuffer> MappedDensityMap;
+
+// Returns the distance from v to the segment from a to b
+// -----
+// addLineSmoothed() with SMOOTH_CAPSULE works out the same distance
+// for a whole row of cells at once
 float pointLineDistance(glm::vec3 a, glm::vec3 b, glm::vec3 v);
\ No newline at end of file
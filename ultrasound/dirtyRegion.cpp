@@ -0,0 +1,107 @@
+#include "dirtyRegion.h"
+#include "atomics.h"
+
+#include <algorithm>
+#include <climits>
+
+DirtyRegion::DirtyRegion(glm::ivec3 dims) {
+	this->dims = dims;
+
+	bricksX = (dims.x + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksY = (dims.y + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksZ = (dims.z + BRICK_SIZE - 1) / BRICK_SIZE;
+
+	size_t bricks = size_t(bricksX) * bricksY * bricksZ;
+	bits.assign((bricks + 63) / 64, 0);
+
+	reset();
+}
+
+void DirtyRegion::markBox(glm::ivec3 min, glm::ivec3 max) {
+	if (glm::any(glm::greaterThanEqual(min, max))) {
+		return;
+	}
+
+	boxMin = glm::min(boxMin, min);
+	boxMax = glm::max(boxMax, max);
+
+	glm::ivec3 first = min >> BRICK_SHIFT;
+	glm::ivec3 last = (max - 1) >> BRICK_SHIFT;
+
+	for (int bx = first.x; bx <= last.x; bx++) {
+		for (int by = first.y; by <= last.y; by++) {
+			for (int bz = first.z; bz <= last.z; bz++) {
+				size_t brick = brickIndex(bx, by, bz);
+				bits[brick >> 6] |= uint64_t(1) << (brick & 63);
+			}
+		}
+	}
+}
+
+void DirtyRegion::markAll() {
+	size_t bricks = size_t(bricksX) * bricksY * bricksZ;
+
+	std::fill(bits.begin(), bits.end(), ~uint64_t(0));
+
+	// Keeps the bits past the last brick clear,
+	// so countDirtyBricks() does not count them
+	if (bricks % 64 != 0) {
+		bits.back() = (uint64_t(1) << (bricks % 64)) - 1;
+	}
+
+	boxMin = glm::ivec3(0);
+	boxMax = dims;
+}
+
+void DirtyRegion::markBrickConcurrent(int x, int y, int z) {
+	size_t brick = brickIndex(x >> BRICK_SHIFT, y >> BRICK_SHIFT, z >> BRICK_SHIFT);
+	uint64_t bit = uint64_t(1) << (brick & 63);
+	uint64_t& word = bits[brick >> 6];
+
+	// Only reads while the bit is set already (which it usually is),
+	// since the or would take the cache line away from the other threads
+	if ((asAtomic(word).load(std::memory_order_relaxed) & bit) == 0) {
+		asAtomic(word).fetch_or(bit, std::memory_order_relaxed);
+	}
+}
+
+void DirtyRegion::growBoxConcurrent(glm::ivec3 min, glm::ivec3 max) {
+	for (int axis = 0; axis < 3; axis++) {
+		atomicMin(boxMin[axis], min[axis]);
+		atomicMax(boxMax[axis], max[axis]);
+	}
+}
+
+void DirtyRegion::merge(const DirtyRegion& other) {
+	for (size_t i = 0; i < bits.size(); i++) {
+		bits[i] |= other.bits[i];
+	}
+
+	boxMin = glm::min(boxMin, other.boxMin);
+	boxMax = glm::max(boxMax, other.boxMax);
+}
+
+void DirtyRegion::reset() {
+	std::fill(bits.begin(), bits.end(), 0);
+
+	boxMin = glm::ivec3(INT_MAX);
+	boxMax = glm::ivec3(INT_MIN);
+
+	lastBrick = SIZE_MAX;
+}
+
+size_t DirtyRegion::countDirtyBricks() const {
+	size_t count = 0;
+
+	for (size_t i = 0; i < bits.size(); i++) {
+		uint64_t word = bits[i];
+
+		// Clears the lowest set bit until none are left
+		while (word != 0) {
+			word &= word - 1;
+			count++;
+		}
+	}
+
+	return count;
+}
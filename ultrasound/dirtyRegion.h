@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "brickBuffer.h"
+
+// Records which parts of a density map changed
+// -----
+// Changes are tracked two ways: one bit for every 8x8x8 brick
+// (the same bricks as BrickBuffer), and a box around everything changed.
+// Both are conservative, so a brick or cell can be marked without changing,
+// but nothing can change without being marked.
+// Whoever consumes the changes (like the vertex buffer upload in main.cpp)
+// looks at them and then calls reset().
+class DirtyRegion {
+private:
+	// Number of cells along x, y, and z
+	glm::ivec3 dims;
+
+	// Number of bricks along x, y, and z
+	int bricksX;
+	int bricksY;
+	int bricksZ;
+
+	// One bit per brick, counting x-major like BrickBuffer::brickIndex()
+	std::vector<uint64_t> bits;
+
+	// Box around every changed cell
+	// min is inclusive and max is exclusive, and the box is empty if min >= max
+	glm::ivec3 boxMin;
+	glm::ivec3 boxMax;
+
+	// Last brick marked by markCell(), so runs of cells
+	// in the same brick only set the bit once
+	size_t lastBrick;
+
+	size_t brickIndex(int bx, int by, int bz) const {
+		return (size_t(bx) * bricksY + by) * bricksZ + bz;
+	}
+
+public:
+	DirtyRegion(glm::ivec3 dims);
+
+	// Marks the cell at (x, y, z) as changed
+	void markCell(int x, int y, int z) {
+		size_t brick = brickIndex(x >> BRICK_SHIFT, y >> BRICK_SHIFT, z >> BRICK_SHIFT);
+
+		if (brick != lastBrick) {
+			bits[brick >> 6] |= uint64_t(1) << (brick & 63);
+			lastBrick = brick;
+		}
+
+		boxMin = glm::min(boxMin, glm::ivec3(x, y, z));
+		boxMax = glm::max(boxMax, glm::ivec3(x + 1, y + 1, z + 1));
+	}
+
+	// Marks every cell from min (inclusive) to max (exclusive) as changed
+	void markBox(glm::ivec3 min, glm::ivec3 max);
+
+	// Marks every cell as changed
+	void markAll();
+
+	// Marks the brick holding the cell at (x, y, z) as changed, leaving the box alone
+	// -----
+	// Unlike markCell(), this is safe to call from several threads at once
+	// (the bit is set with an atomic or), as long as they only call
+	// the concurrent functions while they do
+	void markBrickConcurrent(int x, int y, int z);
+
+	// Grows the box around every changed cell to take in
+	// every cell from min (inclusive) to max (exclusive)
+	// Safe to call from several threads at once, like markBrickConcurrent()
+	void growBoxConcurrent(glm::ivec3 min, glm::ivec3 max);
+
+	// Marks everything other marked as changed
+	// other must be for the same dimensions
+	// -----
+	// Lets threads that write different cells keep a region each
+	// and combine them afterwards, since two threads marking bricks
+	// that share a word of bits would race
+	void merge(const DirtyRegion& other);
+
+	// Forgets every change
+	void reset();
+
+	// Returns true if nothing changed since the last reset()
+	bool isClean() const { return glm::any(glm::greaterThanEqual(boxMin, boxMax)); }
+
+	// Returns true if the brick at (bx, by, bz) changed
+	// (bx, by, bz) are brick coordinates, so cell (x, y, z) is in brick (x / 8, y / 8, z / 8)
+	bool isBrickDirty(int bx, int by, int bz) const {
+		size_t brick = brickIndex(bx, by, bz);
+		return (bits[brick >> 6] >> (brick & 63)) & 1;
+	}
+
+	// Returns the number of bricks that changed
+	size_t countDirtyBricks() const;
+
+	// Returns the number of bricks along x, y, and z
+	glm::ivec3 getBrickCounts() const { return glm::ivec3(bricksX, bricksY, bricksZ); }
+
+	// Returns the corners of the box around every changed cell
+	// min is inclusive and max is exclusive
+	glm::ivec3 getMin() const { return boxMin; }
+	glm::ivec3 getMax() const { return boxMax; }
+};
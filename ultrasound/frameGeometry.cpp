@@ -0,0 +1,37 @@
+#include "frameGeometry.h"
+
+#include <cmath>
+
+FrameLut::FrameLut() {
+	// No frame has zero lines, so this never matches
+	geometry.sectorAngle = 0.0f;
+	geometry.depth = 0.0f;
+	geometry.lines = 0;
+	geometry.samplesPerLine = 0;
+}
+
+FrameLut::FrameLut(const FrameGeometry& geometry) {
+	this->geometry = geometry;
+
+	size_t count = size_t(geometry.lines) * geometry.samplesPerLine;
+	x.resize(count);
+	y.assign(count, 0.0f);
+	z.resize(count);
+
+	for (int line = 0; line < geometry.lines; line++) {
+		// A single line goes straight down the middle
+		float t = geometry.lines > 1 ? float(line) / (geometry.lines - 1) : 0.5f;
+		float angle = (t - 0.5f) * geometry.sectorAngle;
+
+		float dx = std::sin(angle);
+		float dz = std::cos(angle);
+
+		for (int i = 0; i < geometry.samplesPerLine; i++) {
+			float r = geometry.depth * (i + 0.5f) / geometry.samplesPerLine;
+			size_t k = size_t(line) * geometry.samplesPerLine + i;
+
+			x[k] = r * dx;
+			z[k] = r * dz;
+		}
+	}
+}
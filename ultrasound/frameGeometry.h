@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Shape of one frame of a sector (fan) probe
+// -----
+// In probe space the probe sits at the origin and looks along +z.
+// The lines fan out evenly across x, from -sectorAngle / 2 to +sectorAngle / 2,
+// and the frame lies in the plane y = 0.
+// Sample i of a line is in the middle of its stretch of the line,
+// (i + 0.5) / samplesPerLine of the way to depth, like addLine() samples.
+struct FrameGeometry {
+	// Angle between the first and the last line, in radians
+	float sectorAngle;
+
+	// Length of every line, in world units
+	float depth;
+
+	int lines;
+	int samplesPerLine;
+};
+
+// How addFrame() turns a frame into cells
+enum ReconstructionMode {
+	RECONSTRUCT_FORWARD, // every sample is written to the cell it lands in
+	RECONSTRUCT_BACKWARD // every cell the frame passes through looks its value up in the frame
+};
+
+inline bool operator==(const FrameGeometry& a, const FrameGeometry& b) {
+	return a.sectorAngle == b.sectorAngle && a.depth == b.depth
+		&& a.lines == b.lines && a.samplesPerLine == b.samplesPerLine;
+}
+
+inline bool operator!=(const FrameGeometry& a, const FrameGeometry& b) {
+	return !(a == b);
+}
+
+// Probe space position of every sample of a FrameGeometry
+// -----
+// Worked out once per geometry, so a frame only has to move the table
+// to where the probe is instead of stepping along every line again.
+// Positions are stored one array per axis, line after line,
+// in the same order as the samples passed to addFrame().
+class FrameLut {
+private:
+	FrameGeometry geometry;
+
+	std::vector<float> x;
+	std::vector<float> y;
+	std::vector<float> z;
+
+public:
+	// Empty table that matches no geometry
+	FrameLut();
+
+	FrameLut(const FrameGeometry& geometry);
+
+	const FrameGeometry& getGeometry() const { return geometry; }
+
+	// Number of samples in a frame (lines * samplesPerLine)
+	size_t size() const { return x.size(); }
+
+	// Position of every sample along x, y, and z
+	const float* getX() const { return x.data(); }
+	const float* getY() const { return y.data(); }
+	const float* getZ() const { return z.data(); }
+};
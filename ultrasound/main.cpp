@@ -8,6 +8,8 @@
 
 #include "shader.h"
 #include "camera.h"
+#include "benchmark.h"
+#include "checks.h"
 
 #include "densitymap.h"
 
@@ -36,6 +38,7 @@ void processKeyboardInput(GLFWwindow* window);
 // This function is pretty slow right now (a few hundred milliseconds)
 // because it writes several megabytes of data at once to the graphics card,
 // but it will be optimized soon
+// It does nothing if no cell changed since the last update
 void updateVertexBuffer(unsigned int& VBO, DensityMap& grid);
 
 // Demo functions to show what the volume map looks like
@@ -50,7 +53,20 @@ bool firstMouse;
 // Creating a Camera object
 Camera cam;
 
-int main() {
+int main(int argc, char** argv) {
+	// "ultrasound --benchmark" prints the benchmarks in benchmark.h
+	// and exits without opening a window
+	if (argc > 1 && std::string(argv[1]) == "--benchmark") {
+		runBenchmarks();
+		return 0;
+	}
+
+	// "ultrasound --check" runs the checks in checks.h
+	// and exits with 1 if any of them failed
+	if (argc > 1 && std::string(argv[1]) == "--check") {
+		return runChecks() == 0 ? 0 : 1;
+	}
+
 	// Window title
 	std::string windowTitle = "Density Map";
 
@@ -109,6 +125,9 @@ int main() {
 	// in a form useful to OpenGL
 	std::vector<float> cellPositions = grid.getVertices();
 	std::vector<float> cellDensities = grid.getDensities();
+
+	// Everything changed so far is about to be uploaded
+	grid.resetDirty();
 	
 	// Initializing the buffers storing the vertices
 	// of the volume map on the graphics card
@@ -211,9 +230,18 @@ int main() {
 		glm::dmat4 projection = glm::perspective(glm::radians(cam.fov), double(SCR_WIDTH) / SCR_HEIGHT, 0.01, 500.0);
 		glm::dmat4 camView = cam.getViewMatrix();
 
-		int dim = grid.getDim();
-		glm::dmat4 model = glm::scale(glm::dmat4{}, glm::dvec3(10.0 / (dim - 1), 10.0 / (dim - 1), 10.0 / (dim - 1)));
-		model = glm::translate(model, glm::dvec3(-(dim - 1) / 2.0, -(dim - 1) / 2.0, -(dim - 1) / 2.0));
+		// The vertices are cell indices, so they are scaled by the cell spacing
+		// and the longest side of the volume map is fit into the 10 unit box
+		glm::dvec3 dims = glm::dvec3(grid.getDims());
+		glm::dvec3 spacing = glm::dvec3(grid.getSpacing());
+		glm::dvec3 extent = (dims - 1.0) * spacing;
+		double fit = 10.0 / glm::max(extent.x, glm::max(extent.y, extent.z));
+
+		glm::dmat4 model = glm::scale(glm::dmat4{}, fit * spacing);
+		model = glm::translate(model, -(dims - 1.0) / 2.0);
+
+		// The white lines are shrunk along the shorter sides to match
+		glm::dmat4 lineModel = glm::scale(glm::dmat4{}, extent * fit / 10.0);
 
 		// Drawing the volume map
 		cellShader.use();
@@ -228,7 +256,7 @@ int main() {
 		lineShader.use();
 		lineShader.setMat4("projection", projection);
 		lineShader.setMat4("view", camView);
-		lineShader.setMat4("model", glm::dmat4{});
+		lineShader.setMat4("model", lineModel);
 
 		glBindVertexArray(lineVAO);
 		glDrawArrays(GL_LINES, 0, 24);
@@ -296,25 +324,25 @@ void cursorPosMovementCallback(GLFWwindow* window, double xpos, double ypos) {
 void sphereDemo(DensityMap& grid) {
 	// Adds a sphere to the center of the volume map
 
-	int dim = grid.getDim();
+	glm::ivec3 dims = grid.getDims();
 
-	for (int i = 0; i < dim; i++) {
-		for (int j = 0; j < dim; j++) {
-			for (int k = 0; k < dim; k++) {
-				float xd = i - ((dim - 1) / 2.0);
-				float yd = j - ((dim - 1) / 2.0);
-				float zd = k - ((dim - 1) / 2.0);
+	for (int i = 0; i < dims.x; i++) {
+		for (int j = 0; j < dims.y; j++) {
+			for (int k = 0; k < dims.z; k++) {
+				float xd = i - ((dims.x - 1) / 2.0);
+				float yd = j - ((dims.y - 1) / 2.0);
+				float zd = k - ((dims.z - 1) / 2.0);
 
-				float mxd = (dim - 1) / 2.0;
-				float myd = (dim - 1) / 2.0;
-				float mzd = (dim - 1) / 2.0;
+				float mxd = (dims.x - 1) / 2.0;
+				float myd = (dims.y - 1) / 2.0;
+				float mzd = (dims.z - 1) / 2.0;
 
 				float distance = sqrt(xd * xd + yd * yd + zd * zd);
 				float maxDistance = sqrt(mxd * mxd + myd * myd + mzd * mzd);
 				float shade = (maxDistance - distance) / maxDistance;
 				shade = shade * shade;
 
-				grid.cells[i][j][k] = shade;
+				grid.set(i, j, k, shade);
 			}
 		}
 	}
@@ -324,33 +352,40 @@ void fanDemo(DensityMap& grid) {
 	// Adds a fan shape to the volume map
 	// using the DensityMap::addLine() function
 
-	glm::vec3 vertex = { 0.5, 0.5, 0.5 };
+	// The fan is placed relative to the size of the volume map
+	glm::vec3 extent = grid.getExtent();
+	glm::vec3 vertex = extent * 0.5f;
 
 	float a1 = 1;
 	float a2 = 1;
 
-	float r = 0.3;
+	float r = 0.3 * glm::min(extent.x, glm::min(extent.y, extent.z));
+
+	// Every line has the same samples, so they are made once and passed as a view
+	std::vector<float> vals(1000, 1.0f);
 
 	for (; a2 <= 3; a2 += 0.01) {
 		float x = r * sin(a1) * cos(a2);
 		float y = r * sin(a1) * sin(a2);
 		float z = r * cos(a1);
 
-		std::vector<float> vals;
-
-		for (int i = 0; i < 1000; i++) {
-			vals.push_back(1);
-		}
-
 		grid.addLine(vertex, vertex + glm::vec3(x, y, z), vals);
 	}
 }
 
 void updateVertexBuffer(unsigned int& VBO, DensityMap& grid) {
+	// Nothing to upload if no cell changed since the last upload
+	if (grid.getDirty().isClean()) {
+		return;
+	}
+
 	// Gets the vertices from the density map
 	std::vector<float> densities = grid.getDensities();
 
 	// Writes the vertices to the vertex buffer on the graphics card
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, densities.size() * sizeof(float), densities.data());
+
+	// The graphics card is up to date now
+	grid.resetDirty();
 }
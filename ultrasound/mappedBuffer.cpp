@@ -0,0 +1,303 @@
+#include "mappedBuffer.h"
+#include "voxelTypes.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+template<typename T>
+MappedBuffer<T>::MappedBuffer(int dimX, int dimY, int dimZ) : MappedBuffer(dimX, dimY, dimZ, "") {}
+
+template<typename T>
+MappedBuffer<T>::MappedBuffer(int dimX, int dimY, int dimZ, const std::string& path) {
+	this->dimX = dimX;
+	this->dimY = dimY;
+	this->dimZ = dimZ;
+
+	// Same padding as VoxelBuffer
+	size_t rowAlignment = VOXEL_ALIGNMENT / sizeof(T);
+	rowStride = (dimZ + rowAlignment - 1) / rowAlignment * rowAlignment;
+	sliceStride = dimY * rowStride;
+
+	bytes = size() * sizeof(T);
+
+	// The file is new (or cut to nothing first), so it reads as zeroes
+	open(path);
+}
+
+template<typename T>
+MappedBuffer<T>::~MappedBuffer() {
+	close();
+}
+
+template<typename T>
+MappedBuffer<T>::MappedBuffer(MappedBuffer<T>&& other) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	rowStride = other.rowStride;
+	sliceStride = other.sliceStride;
+	voxels = other.voxels;
+	bytes = other.bytes;
+	file = other.file;
+#ifdef _WIN32
+	mapping = other.mapping;
+	other.mapping = NULL;
+	other.file = INVALID_HANDLE_VALUE;
+#else
+	other.file = -1;
+#endif
+
+	other.voxels = nullptr;
+}
+
+template<typename T>
+MappedBuffer<T>& MappedBuffer<T>::operator=(MappedBuffer<T>&& other) {
+	if (this != &other) {
+		close();
+
+		dimX = other.dimX;
+		dimY = other.dimY;
+		dimZ = other.dimZ;
+		rowStride = other.rowStride;
+		sliceStride = other.sliceStride;
+		voxels = other.voxels;
+		bytes = other.bytes;
+		file = other.file;
+#ifdef _WIN32
+		mapping = other.mapping;
+		other.mapping = NULL;
+		other.file = INVALID_HANDLE_VALUE;
+#else
+		other.file = -1;
+#endif
+
+		other.voxels = nullptr;
+	}
+
+	return *this;
+}
+
+#ifdef _WIN32
+
+template<typename T>
+void MappedBuffer<T>::open(const std::string& path) {
+	if (path.empty()) {
+		// Unnamed scratch file that disappears when the handle is closed
+		char directory[MAX_PATH];
+		char name[MAX_PATH];
+		GetTempPathA(MAX_PATH, directory);
+		GetTempFileNameA(directory, "dmp", 0, name);
+
+		file = CreateFileA(name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, NULL);
+	}
+	else {
+		file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL, NULL);
+	}
+
+	if (file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("Failed to create the file for a MappedBuffer");
+	}
+
+	// Creating a mapping larger than the file grows the file,
+	// and the new part reads as zeroes on every local file system
+	unsigned long long size64 = bytes;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READWRITE, DWORD(size64 >> 32), DWORD(size64 & 0xffffffff), NULL);
+
+	if (mapping == NULL) {
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map the file for a MappedBuffer");
+	}
+
+	voxels = static_cast<T*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes));
+
+	if (voxels == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map the file for a MappedBuffer");
+	}
+}
+
+template<typename T>
+void MappedBuffer<T>::close() {
+	if (voxels != nullptr) {
+		UnmapViewOfFile(voxels);
+		CloseHandle(mapping);
+		CloseHandle(file);
+	}
+
+	voxels = nullptr;
+}
+
+template<typename T>
+void MappedBuffer<T>::adviseBytes(size_t begin, size_t end, AccessPattern pattern) {
+	char* start = reinterpret_cast<char*>(voxels) + begin;
+
+	// Windows has no read-ahead hints for a mapped view,
+	// so only the prefetch and drop hints do anything
+	if (pattern == ACCESS_WILLNEED) {
+#if _WIN32_WINNT >= 0x0602
+		WIN32_MEMORY_RANGE_ENTRY range;
+		range.VirtualAddress = start;
+		range.NumberOfBytes = end - begin;
+		PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#endif
+	}
+	else if (pattern == ACCESS_DONTNEED) {
+		// Unlocking pages that are not locked removes them from the working set
+		FlushViewOfFile(start, end - begin);
+		VirtualUnlock(start, end - begin);
+	}
+}
+
+template<typename T>
+void MappedBuffer<T>::flush() {
+	FlushViewOfFile(voxels, 0);
+	FlushFileBuffers(file);
+}
+
+template<typename T>
+void MappedBuffer<T>::clear() {
+	// A file cannot change size while it is mapped on Windows
+	memset(voxels, 0, bytes);
+}
+
+#else
+
+template<typename T>
+void MappedBuffer<T>::open(const std::string& path) {
+	if (path.empty()) {
+		// Unnamed scratch file: it is deleted right away
+		// and disappears for good when the descriptor is closed
+		const char* directory = getenv("TMPDIR");
+		std::string pattern = std::string(directory != nullptr ? directory : "/tmp") + "/densitymap-XXXXXX";
+		std::vector<char> name(pattern.begin(), pattern.end());
+		name.push_back('\0');
+
+		file = mkstemp(name.data());
+		if (file != -1) {
+			unlink(name.data());
+		}
+	}
+	else {
+		file = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	}
+
+	if (file == -1) {
+		throw std::runtime_error("Failed to create the file for a MappedBuffer");
+	}
+
+	// Growing the file leaves a hole that reads as zeroes
+	// and takes no disk space until it is written
+	if (ftruncate(file, bytes) != 0) {
+		::close(file);
+		throw std::runtime_error("Failed to resize the file for a MappedBuffer");
+	}
+
+	void* view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+	if (view == MAP_FAILED) {
+		::close(file);
+		throw std::runtime_error("Failed to map the file for a MappedBuffer");
+	}
+
+	voxels = static_cast<T*>(view);
+}
+
+template<typename T>
+void MappedBuffer<T>::close() {
+	if (voxels != nullptr) {
+		munmap(voxels, bytes);
+		::close(file);
+	}
+
+	voxels = nullptr;
+}
+
+template<typename T>
+void MappedBuffer<T>::adviseBytes(size_t begin, size_t end, AccessPattern pattern) {
+	int advice = MADV_NORMAL;
+
+	switch (pattern) {
+	case ACCESS_NORMAL: advice = MADV_NORMAL; break;
+	case ACCESS_SEQUENTIAL: advice = MADV_SEQUENTIAL; break;
+	case ACCESS_RANDOM: advice = MADV_RANDOM; break;
+	case ACCESS_WILLNEED: advice = MADV_WILLNEED; break;
+	case ACCESS_DONTNEED: advice = MADV_DONTNEED; break;
+	}
+
+	// madvise() only takes whole pages
+	size_t page = size_t(sysconf(_SC_PAGESIZE));
+	begin = begin / page * page;
+
+	// Dirty pages of a shared mapping are written back before they are dropped,
+	// so MADV_DONTNEED does not lose anything here
+	madvise(reinterpret_cast<char*>(voxels) + begin, end - begin, advice);
+}
+
+template<typename T>
+void MappedBuffer<T>::flush() {
+	msync(voxels, bytes, MS_SYNC);
+}
+
+template<typename T>
+void MappedBuffer<T>::clear() {
+	// Cutting the file to nothing and growing it again drops every page,
+	// and the whole view reads as zeroes afterwards
+	if (ftruncate(file, 0) != 0 || ftruncate(file, bytes) != 0) {
+		memset(voxels, 0, bytes);
+	}
+}
+
+#endif
+
+template<typename T>
+void MappedBuffer<T>::advise(AccessPattern pattern) {
+	adviseBytes(0, bytes, pattern);
+}
+
+template<typename T>
+void MappedBuffer<T>::adviseSlices(int xBegin, int xEnd, AccessPattern pattern) {
+	if (xBegin < 0) xBegin = 0;
+	if (xEnd > dimX) xEnd = dimX;
+	if (xBegin >= xEnd) return;
+
+	adviseBytes(xBegin * sliceStride * sizeof(T), xEnd * sliceStride * sizeof(T), pattern);
+}
+
+template<typename T>
+void MappedBuffer<T>::clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+		return;
+	}
+
+	// Whole slices are one block each, padding included
+	if (minY == 0 && maxY == dimY && minZ == 0 && maxZ == dimZ) {
+		memset(voxels + index(minX, 0, 0), 0, (maxX - minX) * sliceStride * sizeof(T));
+		return;
+	}
+
+	for (int x = minX; x < maxX; x++) {
+		for (int y = minY; y < maxY; y++) {
+			memset(voxels + index(x, y, minZ), 0, (maxZ - minZ) * sizeof(T));
+		}
+	}
+}
+
+template class MappedBuffer<float>;
+template class MappedBuffer<uint8_t>;
+template class MappedBuffer<uint16_t>;
+template class MappedBuffer<Half>;
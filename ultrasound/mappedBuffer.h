@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "voxelBuffer.h"
+
+// Hints about how a MappedBuffer is about to be used
+// (these are passed on to madvise())
+enum AccessPattern {
+	ACCESS_NORMAL,     // no particular order
+	ACCESS_SEQUENTIAL, // front to back, like getDensities() (read ahead aggressively)
+	ACCESS_RANDOM,     // scattered, like insertion from many angles (do not read ahead)
+	ACCESS_WILLNEED,   // start reading it in now
+	ACCESS_DONTNEED    // written back and not needed soon (the memory can be reused)
+};
+
+// 3D array of voxels of type T that lives in a memory-mapped file
+// -----
+// The layout is exactly the same as VoxelBuffer (padded rows along z),
+// but the cells are pages of a file instead of heap memory,
+// so the operating system writes them out and reads them back in as needed
+// and the array can be much larger than the RAM in the machine.
+// -----
+// With no file name, an unnamed temporary file is used and deleted afterwards.
+// With a file name, the file is created or overwritten,
+// and keeps the cells after flush() or after the buffer is destroyed.
+// -----
+// Can be moved but not copied
+// Has the same accessor interface as VoxelBuffer (see BasicDensityMap)
+// Instantiated in mappedBuffer.cpp for every type in voxelTypes.h
+template<typename T>
+class MappedBuffer {
+private:
+	int dimX;
+	int dimY;
+	int dimZ;
+
+	// Distance in voxels between (x, y, z) and (x, y + 1, z)
+	size_t rowStride;
+
+	// Distance in voxels between (x, y, z) and (x + 1, y, z)
+	size_t sliceStride;
+
+	// Start of the mapped view of the file
+	T* voxels;
+
+	// Size of the file and the view in bytes
+	size_t bytes;
+
+	// Operating system handles of the file (and, on Windows, of the mapping)
+#ifdef _WIN32
+	void* file;
+	void* mapping;
+#else
+	int file;
+#endif
+
+	void open(const std::string& path);
+	void close();
+
+	// Passes pattern on to the operating system for bytes [begin, end) of the view
+	void adviseBytes(size_t begin, size_t end, AccessPattern pattern);
+
+public:
+	MappedBuffer(int dimX, int dimY, int dimZ);
+	MappedBuffer(int dimX, int dimY, int dimZ, const std::string& path);
+	~MappedBuffer();
+
+	MappedBuffer(const MappedBuffer& other) = delete;
+	MappedBuffer& operator=(const MappedBuffer& other) = delete;
+	MappedBuffer(MappedBuffer&& other);
+	MappedBuffer& operator=(MappedBuffer&& other);
+
+	// Position of (x, y, z) in data()
+	size_t index(int x, int y, int z) const {
+		return x * sliceStride + y * rowStride + z;
+	}
+
+	// Indexed access without bounds checks
+	T& operator()(int x, int y, int z) { return voxels[index(x, y, z)]; }
+	const T& operator()(int x, int y, int z) const { return voxels[index(x, y, z)]; }
+
+	// Pointer to the first cell of the row at (x, y)
+	T* row(int x, int y) { return voxels + index(x, y, 0); }
+	const T* row(int x, int y) const { return voxels + index(x, y, 0); }
+
+	// Rows are contiguous, so scratch is never touched
+	const T* readRow(int x, int y, T* /*scratch*/) const { return row(x, y); }
+
+	// Raw access to the whole mapped view, padding included
+	T* data() { return voxels; }
+	const T* data() const { return voxels; }
+
+	// Number of voxels in data(), padding included
+	size_t size() const { return dimX * sliceStride; }
+
+	Span<T> span() { return Span<T>(voxels, size()); }
+	Span<const T> span() const { return Span<const T>(voxels, size()); }
+
+	size_t getRowStride() const { return rowStride; }
+	size_t getSliceStride() const { return sliceStride; }
+
+	// Number of bytes in the file
+	// (only the pages in use are actually in RAM)
+	size_t memoryUsage() const { return bytes; }
+
+	// Tells the operating system how the whole buffer is about to be used
+	void advise(AccessPattern pattern);
+
+	// Tells the operating system how the slices x = xBegin to xEnd - 1 are about to be used
+	// -----
+	// Each slice is contiguous in the file, so this is the way
+	// to prefetch or drop the part of the volume a sweep is in
+	void adviseSlices(int xBegin, int xEnd, AccessPattern pattern);
+
+	// Writes every changed page back to the file and waits until it is on disk
+	void flush();
+
+	// Overwrites every cell with zero
+	// -----
+	// Where possible the file is cut to nothing and grown again,
+	// which frees its disk blocks instead of writing zeroes to every page
+	void clear();
+
+	// Overwrites every cell from (minX, minY, minZ) (inclusive)
+	// to (maxX, maxY, maxZ) (exclusive) with zero
+	void clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+};
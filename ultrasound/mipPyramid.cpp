@@ -0,0 +1,42 @@
+#include "mipPyramid.h"
+
+MipLevel::MipLevel(glm::ivec3 dims, glm::vec3 spacing) {
+	this->dims = dims;
+	this->spacing = spacing;
+
+	cells.assign(size_t(dims.x) * dims.y * dims.z, 0.0f);
+}
+
+void MipLevel::clear() {
+	std::fill(cells.begin(), cells.end(), 0.0f);
+}
+
+void MipPyramid::enable(glm::ivec3 dims, glm::vec3 spacing, int levels) {
+	disable();
+
+	while (glm::any(glm::greaterThan(dims, glm::ivec3(1)))) {
+		if (levels > 0 && int(maxLevels.size()) == levels) {
+			break;
+		}
+
+		// Each level covers the same space with half as many cells
+		// (rounded up, so odd sides keep their last cell)
+		dims = (dims + 1) / 2;
+		spacing *= 2.0f;
+
+		maxLevels.push_back(MipLevel(dims, spacing));
+		averageLevels.push_back(MipLevel(dims, spacing));
+	}
+}
+
+void MipPyramid::disable() {
+	maxLevels.clear();
+	averageLevels.clear();
+}
+
+void MipPyramid::clear() {
+	for (size_t i = 0; i < maxLevels.size(); i++) {
+		maxLevels[i].clear();
+		averageLevels[i].clear();
+	}
+}
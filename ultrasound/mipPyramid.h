@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "voxelBuffer.h"
+
+// How the 2x2x2 cells below a mip cell are combined into it
+enum MipReduction {
+	MIP_MAX,     // the brightest of the 8 cells
+	MIP_AVERAGE  // the average of the 8 cells (cells past the edge count as zero)
+};
+
+// One coarser copy of a density map
+// -----
+// Has the same read functions as a density map, so code that only reads
+// (previews, coarse-to-fine searches) can use a level instead of the full map.
+// Cells are floats stored z fastest, without padding.
+class MipLevel {
+private:
+	glm::ivec3 dims;
+	glm::vec3 spacing;
+
+	std::vector<float> cells;
+
+public:
+	MipLevel(glm::ivec3 dims, glm::vec3 spacing);
+
+	// Position of (x, y, z) in data()
+	size_t index(int x, int y, int z) const {
+		return (size_t(x) * dims.y + y) * dims.z + z;
+	}
+
+	// Returns the density at (x, y, z)
+	// There are no bounds checks
+	float get(int x, int y, int z) const { return cells[index(x, y, z)]; }
+
+	// Returns the cell at (x, y, z) for writing
+	// Only the pyramid writes to its levels
+	float& at(int x, int y, int z) { return cells[index(x, y, z)]; }
+
+	// Returns the number of cells along x, y, and z
+	glm::ivec3 getDims() const { return dims; }
+
+	// Returns the size of one cell along x, y, and z
+	glm::vec3 getSpacing() const { return spacing; }
+
+	// Returns the size of the whole level along x, y, and z
+	glm::vec3 getExtent() const { return glm::vec3(dims) * spacing; }
+
+	// Returns every cell as one block of linear memory
+	Span<const float> data() const { return Span<const float>(cells.data(), cells.size()); }
+
+	// Overwrites every cell with zero
+	void clear();
+};
+
+// Chain of mip levels above a density map, each half the size of the one below
+// -----
+// Level 0 is the density map itself, so getLevel(1, ...) is the first
+// level the pyramid stores. Both reductions are kept for every level.
+// -----
+// The pyramid is kept up to date one cell at a time by update():
+// the average moves by the change divided by 8 at every level,
+// and the maximum only moves while it changes, so one update
+// costs about one cell per level (and 8 cell reads per level
+// when the brightest cell of a block gets darker).
+class MipPyramid {
+private:
+	std::vector<MipLevel> maxLevels;
+	std::vector<MipLevel> averageLevels;
+
+	// Returns the largest of the (up to) 8 cells below (x, y, z) in level
+	// Level 0 is read from source
+	template<typename Source>
+	float childMax(const Source& source, int level, int x, int y, int z) const;
+
+public:
+	// Makes the pyramid for a map of dims cells that are spacing large,
+	// with the given number of levels above the map
+	// (0 makes levels until a level is a single cell)
+	// Every level starts out filled with zeroes
+	void enable(glm::ivec3 dims, glm::vec3 spacing, int levels = 0);
+
+	// Frees every level
+	void disable();
+
+	// Returns true if there are any levels
+	bool isEnabled() const { return !maxLevels.empty(); }
+
+	// Returns the number of levels above the map
+	int getLevelCount() const { return int(maxLevels.size()); }
+
+	// Returns one level, 1 being the first level above the map
+	const MipLevel& getLevel(int level, MipReduction reduction) const {
+		return reduction == MIP_MAX ? maxLevels[level - 1] : averageLevels[level - 1];
+	}
+
+	// Tells the pyramid that the cell at (x, y, z) of the map
+	// went from oldValue to newValue
+	// -----
+	// source is the map, which must already hold newValue,
+	// and needs a get(x, y, z) function and a getDims() function
+	template<typename Source>
+	void update(const Source& source, int x, int y, int z, float oldValue, float newValue);
+
+	// Recomputes every level from the map
+	template<typename Source>
+	void rebuild(const Source& source);
+
+	// Overwrites every level with zero
+	void clear();
+};
+
+template<typename Source>
+float MipPyramid::childMax(const Source& source, int level, int x, int y, int z) const {
+	glm::ivec3 below = level == 0 ? source.getDims() : maxLevels[level - 1].getDims();
+
+	int endX = std::min(2 * x + 2, below.x);
+	int endY = std::min(2 * y + 2, below.y);
+	int endZ = std::min(2 * z + 2, below.z);
+
+	float result = 0.0f;
+
+	for (int cx = 2 * x; cx < endX; cx++) {
+		for (int cy = 2 * y; cy < endY; cy++) {
+			for (int cz = 2 * z; cz < endZ; cz++) {
+				float v = level == 0 ? source.get(cx, cy, cz) : maxLevels[level - 1].get(cx, cy, cz);
+				result = std::max(result, v);
+			}
+		}
+	}
+
+	return result;
+}
+
+template<typename Source>
+void MipPyramid::update(const Source& source, int x, int y, int z, float oldValue, float newValue) {
+	if (oldValue == newValue) {
+		return;
+	}
+
+	float averageChange = newValue - oldValue;
+
+	// What the changed cell was and is in the level below
+	float childOld = oldValue;
+	float childNew = newValue;
+	bool maxDone = false;
+
+	for (int level = 0; level < int(maxLevels.size()); level++) {
+		x >>= 1;
+		y >>= 1;
+		z >>= 1;
+
+		// Each cell is an eighth of its parent's average
+		averageChange *= 0.125f;
+		averageLevels[level].at(x, y, z) += averageChange;
+
+		if (maxDone) {
+			continue;
+		}
+
+		float& parent = maxLevels[level].at(x, y, z);
+		float parentOld = parent;
+
+		if (childNew >= parentOld) {
+			// The cell is the new maximum
+			parent = childNew;
+		}
+		else if (childOld >= parentOld) {
+			// The cell was the maximum and got darker,
+			// so another cell of the block might be the maximum now
+			parent = childMax(source, level, x, y, z);
+		}
+
+		// Nothing changes further up once a level stays the same
+		if (parent == parentOld) {
+			maxDone = true;
+		}
+
+		childOld = parentOld;
+		childNew = parent;
+	}
+}
+
+template<typename Source>
+void MipPyramid::rebuild(const Source& source) {
+	for (int level = 0; level < int(maxLevels.size()); level++) {
+		MipLevel& maxLevel = maxLevels[level];
+		MipLevel& averageLevel = averageLevels[level];
+		glm::ivec3 dims = maxLevel.getDims();
+		glm::ivec3 below = level == 0 ? source.getDims() : maxLevels[level - 1].getDims();
+
+		for (int x = 0; x < dims.x; x++) {
+			for (int y = 0; y < dims.y; y++) {
+				for (int z = 0; z < dims.z; z++) {
+					maxLevel.at(x, y, z) = childMax(source, level, x, y, z);
+
+					float sum = 0.0f;
+					for (int cx = 2 * x; cx < std::min(2 * x + 2, below.x); cx++) {
+						for (int cy = 2 * y; cy < std::min(2 * y + 2, below.y); cy++) {
+							for (int cz = 2 * z; cz < std::min(2 * z + 2, below.z); cz++) {
+								sum += level == 0 ? source.get(cx, cy, cz) : averageLevels[level - 1].get(cx, cy, cz);
+							}
+						}
+					}
+
+					averageLevel.at(x, y, z) = sum * 0.125f;
+				}
+			}
+		}
+	}
+}
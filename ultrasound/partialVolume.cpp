@@ -0,0 +1,62 @@
+#include "partialVolume.h"
+
+#include <algorithm>
+
+PartialVolume::PartialVolume() {
+	mode = BLEND_MAX;
+	dims = glm::ivec3(0);
+	bricks = glm::ivec3(0);
+	slotCount = 0;
+}
+
+void PartialVolume::reset(glm::ivec3 dims, BlendMode mode) {
+	this->mode = mode;
+
+	if (dims != this->dims) {
+		this->dims = dims;
+		bricks = (dims + BRICK_SIZE - 1) / BRICK_SIZE;
+		brickSlots.assign(size_t(bricks.x) * bricks.y * bricks.z, 0);
+	}
+	else {
+		// Only the bricks that were used have a slot to forget
+		for (size_t i = 0; i < usedBricks.size(); i++) {
+			brickSlots[usedBricks[i]] = 0;
+		}
+	}
+
+	usedBricks.clear();
+	slotCount = 0;
+}
+
+uint32_t PartialVolume::allocateBrick(size_t brick) {
+	size_t first = size_t(slotCount) * BRICK_VOXELS;
+
+	// Slots from before the last reset() are zeroed when they are handed out again
+	if (first < values.size()) {
+		std::fill_n(values.begin() + first, BRICK_VOXELS, 0.0f);
+		std::fill_n(weights.begin() + first, BRICK_VOXELS, 0.0f);
+	}
+	else {
+		values.resize(first + BRICK_VOXELS, 0.0f);
+		weights.resize(first + BRICK_VOXELS, 0.0f);
+	}
+
+	slotCount++;
+	brickSlots[brick] = slotCount;
+	usedBricks.push_back(brick);
+
+	return slotCount;
+}
+
+glm::ivec3 PartialVolume::brickOrigin(size_t brick) const {
+	int bz = int(brick % bricks.z);
+	int by = int(brick / bricks.z % bricks.y);
+	int bx = int(brick / bricks.z / bricks.y);
+
+	return glm::ivec3(bx, by, bz) * BRICK_SIZE;
+}
+
+size_t PartialVolume::memoryUsage() const {
+	return (values.capacity() + weights.capacity()) * sizeof(float)
+		+ brickSlots.capacity() * sizeof(uint32_t) + usedBricks.capacity() * sizeof(size_t);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "accumulator.h"
+#include "brickBuffer.h"
+
+// What one thread added to a density map, kept apart until it is merged
+// -----
+// Used by BasicDensityMap::addLinesCompounded(): every thread adds its lines
+// to a partial volume of its own, so no two threads ever write the same memory,
+// and the volumes are merged into the map brick by brick afterwards.
+// -----
+// Under BLEND_MAX every cell keeps the brightest value it was given.
+// Under BLEND_MEAN and BLEND_WEIGHTED_MEAN every cell keeps a sum and a weight
+// the same way an Accumulator does, so the sums of several volumes just add up.
+// -----
+// Like SparseBuffer, only the 8x8x8 bricks that got a value have memory,
+// and bricks are indexed like the storage of the map (not the window).
+// reset() hands every brick back to the volume's own pool,
+// so a volume kept between frames stops allocating once it is large enough.
+class PartialVolume {
+private:
+	BlendMode mode;
+
+	glm::ivec3 dims;
+
+	// Number of bricks along x, y, and z
+	glm::ivec3 bricks;
+
+	// Slot of every brick in values and weights, plus one (0 means no slot yet)
+	std::vector<uint32_t> brickSlots;
+
+	// Bricks with a slot, in the order they got it
+	std::vector<size_t> usedBricks;
+
+	// BRICK_VOXELS cells per slot, stored like BrickBuffer bricks
+	// values holds the maximum or the sum, and weights is only used by the sums
+	std::vector<float> values;
+	std::vector<float> weights;
+
+	// Number of slots handed out since the last reset()
+	uint32_t slotCount;
+
+	// Gives the brick a zero-filled slot and returns it (plus one)
+	uint32_t allocateBrick(size_t brick);
+
+public:
+	PartialVolume();
+
+	// Forgets every value and gets ready to take values for a map with dims cells under mode
+	// (BLEND_MAX, BLEND_MEAN, or BLEND_WEIGHTED_MEAN)
+	// The memory of the bricks is kept for the next values
+	void reset(glm::ivec3 dims, BlendMode mode);
+
+	// Index of the brick holding (x, y, z), counting x-major
+	size_t brickIndex(int x, int y, int z) const {
+		return (size_t(x >> BRICK_SHIFT) * bricks.y + (y >> BRICK_SHIFT)) * bricks.z + (z >> BRICK_SHIFT);
+	}
+
+	// Adds value to the cell at (x, y, z) of the storage
+	// weight only counts for BLEND_WEIGHTED_MEAN
+	void add(int x, int y, int z, float value, float weight) {
+		size_t brick = brickIndex(x, y, z);
+		uint32_t slot = brickSlots[brick];
+
+		if (slot == 0) {
+			slot = allocateBrick(brick);
+		}
+
+		size_t i = size_t(slot - 1) * BRICK_VOXELS + brickLocalIndex(x, y, z);
+
+		switch (mode) {
+		case BLEND_MAX:
+			values[i] = values[i] < value ? value : values[i];
+			break;
+		case BLEND_WEIGHTED_MEAN:
+			values[i] += weight * value;
+			weights[i] += weight;
+			break;
+		default:
+			values[i] += value;
+			weights[i] += 1.0f;
+			break;
+		}
+	}
+
+	// Returns the bricks (as brickIndex() values) that got values since the last reset()
+	const std::vector<size_t>& getBricks() const { return usedBricks; }
+
+	// Returns the first cell of the values and the weights of a brick,
+	// or null pointers if the brick got no values
+	// Cells are at brickLocalIndex() from there
+	const float* brickValues(size_t brick) const {
+		uint32_t slot = brickSlots[brick];
+		return slot == 0 ? nullptr : values.data() + size_t(slot - 1) * BRICK_VOXELS;
+	}
+
+	const float* brickWeights(size_t brick) const {
+		uint32_t slot = brickSlots[brick];
+		return slot == 0 ? nullptr : weights.data() + size_t(slot - 1) * BRICK_VOXELS;
+	}
+
+	// Returns the first cell of a brick
+	glm::ivec3 brickOrigin(size_t brick) const;
+
+	// Number of bytes used by the bricks and the tables
+	size_t memoryUsage() const;
+};
@@ -0,0 +1,35 @@
+#include "sampleView.h"
+
+#include <stdexcept>
+
+SampleView::SampleView(Span<const uint8_t> samples, Span<const float> lut) {
+	if (!lut.empty() && lut.size() != 256) {
+		throw std::invalid_argument("The lookup table of 8-bit samples needs 256 entries");
+	}
+
+	this->samples = samples.data();
+	this->count = samples.size();
+	this->type = SAMPLES_UINT8;
+	this->lut = lut.empty() ? nullptr : lut.data();
+}
+
+SampleView::SampleView(Span<const uint16_t> samples, Span<const float> lut) {
+	if (!lut.empty() && lut.size() != 65536) {
+		throw std::invalid_argument("The lookup table of 16-bit samples needs 65536 entries");
+	}
+
+	this->samples = samples.data();
+	this->count = samples.size();
+	this->type = SAMPLES_UINT16;
+	this->lut = lut.empty() ? nullptr : lut.data();
+}
+
+SampleView SampleView::slice(size_t first, size_t count) const {
+	size_t bytes = type == SAMPLES_UINT8 ? 1 : type == SAMPLES_UINT16 ? 2 : sizeof(float);
+
+	SampleView result = *this;
+	result.samples = static_cast<const char*>(samples) + first * bytes;
+	result.count = count;
+
+	return result;
+}
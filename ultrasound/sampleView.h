@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "voxelBuffer.h"
+#include "voxelTypes.h"
+
+// Type of the samples a SampleView looks at
+enum SampleType {
+	SAMPLES_FLOAT,  // densities between 0 and 1
+	SAMPLES_UINT8,  // 8-bit envelope samples
+	SAMPLES_UINT16  // 16-bit envelope samples
+};
+
+// Non-owning view of one line (or frame) of samples, as the functions that add data take them
+// -----
+// The samples stay where the caller keeps them (a std::vector, a frame grabber's buffer, ...),
+// so passing a line copies nothing, and integer samples are turned into densities
+// one at a time as they are read, so there is no separate conversion pass.
+// Integer samples go through a lookup table with an entry for every possible sample
+// (256 for uint8_t, 65536 for uint16_t) if one is given, for gain or log compression,
+// and are scaled to 0 to 1 like the cells of a DensityMap8 or DensityMap16 otherwise.
+// -----
+// The samples and the table must outlive the view, which is only a pointer and a size.
+// A std::vector<float> turns into a view by itself, so code written for vectors still works,
+// as long as the vector is not a temporary.
+class SampleView {
+private:
+	const void* samples;
+	size_t count;
+	SampleType type;
+
+	// Density of every possible integer sample, or null to scale them
+	const float* lut;
+
+public:
+	// Empty view
+	SampleView() : samples(nullptr), count(0), type(SAMPLES_FLOAT), lut(nullptr) {}
+
+	SampleView(const std::vector<float>& samples) : samples(samples.data()), count(samples.size()), type(SAMPLES_FLOAT), lut(nullptr) {}
+
+	// A temporary vector would be gone before the view is read
+	SampleView(std::vector<float>&&) = delete;
+
+	SampleView(Span<const float> samples) : samples(samples.data()), count(samples.size()), type(SAMPLES_FLOAT), lut(nullptr) {}
+
+	// lut is empty or has 256 entries
+	// Throws std::invalid_argument if it has any other number
+	SampleView(Span<const uint8_t> samples, Span<const float> lut = Span<const float>());
+
+	// lut is empty or has 65536 entries
+	// Throws std::invalid_argument if it has any other number
+	SampleView(Span<const uint16_t> samples, Span<const float> lut = Span<const float>());
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	SampleType getType() const { return type; }
+
+	// Returns sample i as a density
+	// There are no bounds checks
+	float operator[](size_t i) const {
+		switch (type) {
+		case SAMPLES_UINT8: {
+			uint8_t v = static_cast<const uint8_t*>(samples)[i];
+			return lut ? lut[v] : VoxelTraits<uint8_t>::toFloat(v);
+		}
+		case SAMPLES_UINT16: {
+			uint16_t v = static_cast<const uint16_t*>(samples)[i];
+			return lut ? lut[v] : VoxelTraits<uint16_t>::toFloat(v);
+		}
+		default:
+			return static_cast<const float*>(samples)[i];
+		}
+	}
+
+	// Returns a view of count samples starting at first, with the same type and table
+	// (like one line of a frame)
+	// There are no bounds checks
+	SampleView slice(size_t first, size_t count) const;
+};
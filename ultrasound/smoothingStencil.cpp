@@ -0,0 +1,30 @@
+#include "smoothingStencil.h"
+
+#include <cmath>
+
+SmoothingStencil::SmoothingStencil(int radius, size_t rowStride, size_t sliceStride) {
+	this->radius = radius;
+
+	for (int dx = -radius; dx <= radius; dx++) {
+		for (int dy = -radius; dy <= radius; dy++) {
+			for (int dz = -radius; dz <= radius; dz++) {
+				int squared = dx * dx + dy * dy + dz * dz;
+
+				// Disregards cells outside of the sphere
+				if (squared > radius * radius) {
+					continue;
+				}
+
+				// The radius is measured in cells, not in units
+				float distance = float(sqrt(double(squared)));
+
+				StencilEntry entry = { dx, dy, dz, float(pow(1.25, -distance)) };
+				entries.push_back(entry);
+
+				if (sliceStride != 0) {
+					offsets.push_back(ptrdiff_t(dx) * ptrdiff_t(sliceStride) + ptrdiff_t(dy) * ptrdiff_t(rowStride) + dz);
+				}
+			}
+		}
+	}
+}
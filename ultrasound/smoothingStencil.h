@@ -0,0 +1,202 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// One cell of a SmoothingStencil
+struct StencilEntry {
+	// Offset from the centre cell
+	int dx;
+	int dy;
+	int dz;
+
+	// Brightness of the cell, 1.25 ^ -distance
+	float weight;
+};
+
+// The cells addLineSmoothed() brightens around each sample, worked out once
+// -----
+// Holds every cell within radius of the centre (the sphere test is already done)
+// with the weight the falloff gives it, in the order the old triple loop visited them.
+// For storages with fixed strides, each cell also has its offset in memory
+// from the centre cell, so a stamp that stays inside the storage
+// is a walk over this table with no bounds checks and no index math.
+class SmoothingStencil {
+private:
+	int radius;
+
+	std::vector<StencilEntry> entries;
+
+	// Offset in cells from the centre cell in memory, for every entry
+	// Empty if the stencil was made without strides
+	std::vector<ptrdiff_t> offsets;
+
+public:
+	// Makes the stencil for radius
+	// rowStride and sliceStride are the strides of the storage in cells,
+	// or 0 if it has none (like BrickBuffer)
+	SmoothingStencil(int radius, size_t rowStride = 0, size_t sliceStride = 0);
+
+	int getRadius() const { return radius; }
+
+	// Number of cells in the stencil
+	size_t size() const { return entries.size(); }
+
+	const StencilEntry* getEntries() const { return entries.data(); }
+
+	// Offsets in memory, or nullptr if the stencil has no strides
+	const ptrdiff_t* getOffsets() const { return offsets.empty() ? nullptr : offsets.data(); }
+};
+
+// ln(1.25), so 1.25 ^ -d is exp(-d * SMOOTHING_LN_1_25)
+#define SMOOTHING_LN_1_25 0.22314355131420976
+
+// Square root that can run at compile time (Newton's method)
+constexpr double constSqrt(double v) {
+	if (v <= 0.0) {
+		return 0.0;
+	}
+
+	double x = v > 1.0 ? v : 1.0;
+
+	for (int i = 0; i < 64; i++) {
+		double next = 0.5 * (x + v / x);
+
+		if (next == x) {
+			break;
+		}
+
+		x = next;
+	}
+
+	return x;
+}
+
+// e ^ v that can run at compile time (Taylor series, for small v)
+constexpr double constExp(double v) {
+	double sum = 1.0;
+	double term = 1.0;
+
+	for (int n = 1; n < 40; n++) {
+		term *= v / n;
+		sum += term;
+	}
+
+	return sum;
+}
+
+// Half the length of the row of a sphere of radius at (dx, dy),
+// so the row runs from dz = -half to half (-1 if the row is empty)
+constexpr int sphereRowHalf(int radius, int dx, int dy) {
+	int half = -1;
+
+	while ((half + 1) * (half + 1) + dx * dx + dy * dy <= radius * radius) {
+		half++;
+	}
+
+	return half;
+}
+
+// Number of non-empty rows along z in a sphere of radius
+constexpr int sphereRows(int radius) {
+	int rows = 0;
+
+	for (int dx = -radius; dx <= radius; dx++) {
+		for (int dy = -radius; dy <= radius; dy++) {
+			rows += sphereRowHalf(radius, dx, dy) >= 0 ? 1 : 0;
+		}
+	}
+
+	return rows;
+}
+
+// Number of cells in a sphere of radius
+constexpr int sphereCells(int radius) {
+	int cells = 0;
+
+	for (int dx = -radius; dx <= radius; dx++) {
+		for (int dy = -radius; dy <= radius; dy++) {
+			int half = sphereRowHalf(radius, dx, dy);
+			cells += half >= 0 ? 2 * half + 1 : 0;
+		}
+	}
+
+	return cells;
+}
+
+// The cells of a SmoothingStencil of radius R, worked out by the compiler
+// -----
+// The sphere is stored as rows along z, which are contiguous in memory
+// in VoxelBuffer and MappedBuffer, so stamping a row is one short loop
+// over neighbouring cells. Every count is a constant,
+// so the compiler can unroll and vectorize the loops for each radius.
+// The cells are in the same order as in SmoothingStencil,
+// and the weights are the same floats.
+template<int R>
+struct FixedStencilTable {
+	static constexpr int rowCount = sphereRows(R);
+	static constexpr int cellCount = sphereCells(R);
+
+	// Offset of every row from the centre cell
+	int dx[rowCount];
+	int dy[rowCount];
+
+	// Half the length of every row (see sphereRowHalf())
+	int half[rowCount];
+
+	// Index in weight of the first cell of every row
+	int start[rowCount];
+
+	// Brightness of every cell, row after row
+	float weight[cellCount];
+
+	constexpr FixedStencilTable() : dx(), dy(), half(), start(), weight() {}
+};
+
+template<int R>
+constexpr FixedStencilTable<R> makeFixedStencilTable() {
+	FixedStencilTable<R> table;
+
+	// The weight only depends on the squared distance,
+	// which is never more than R * R
+	float weights[R * R + 1] = {};
+	for (int squared = 0; squared <= R * R; squared++) {
+		// Rounded to float first, like SmoothingStencil does
+		float distance = float(constSqrt(double(squared)));
+		weights[squared] = float(constExp(-double(distance) * SMOOTHING_LN_1_25));
+	}
+
+	int row = 0;
+	int cell = 0;
+
+	for (int dx = -R; dx <= R; dx++) {
+		for (int dy = -R; dy <= R; dy++) {
+			int half = sphereRowHalf(R, dx, dy);
+
+			if (half < 0) {
+				continue;
+			}
+
+			table.dx[row] = dx;
+			table.dy[row] = dy;
+			table.half[row] = half;
+			table.start[row] = cell;
+			row++;
+
+			for (int dz = -half; dz <= half; dz++) {
+				table.weight[cell++] = weights[dx * dx + dy * dy + dz * dz];
+			}
+		}
+	}
+
+	return table;
+}
+
+// The table for radius R, made once at compile time
+template<int R>
+struct FixedStencil {
+	static constexpr FixedStencilTable<R> table = makeFixedStencilTable<R>();
+};
+
+template<int R>
+constexpr FixedStencilTable<R> FixedStencil<R>::table;
@@ -0,0 +1,213 @@
+#include "sparseBuffer.h"
+#include "voxelTypes.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+template<typename T>
+SparseBuffer<T>::SparseBuffer(int dimX, int dimY, int dimZ) {
+	this->dimX = dimX;
+	this->dimY = dimY;
+	this->dimZ = dimZ;
+
+	bricksX = (dimX + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksY = (dimY + BRICK_SIZE - 1) / BRICK_SIZE;
+	bricksZ = (dimZ + BRICK_SIZE - 1) / BRICK_SIZE;
+
+	// Every brick starts out stale, so it reads from the zero brick
+	BrickEntry empty = { 0, 0 };
+	brickTable.assign(size_t(bricksX) * bricksY * bricksZ, empty);
+	generation = 1;
+
+	// The first chunk holds the zero brick in slot 0
+	T* chunk = static_cast<T*>(alignedAlloc(SPARSE_CHUNK_BRICKS * BRICK_VOXELS * sizeof(T)));
+	memset(chunk, 0, BRICK_VOXELS * sizeof(T));
+	chunks.push_back(chunk);
+
+	usedSlots = 1;
+}
+
+template<typename T>
+SparseBuffer<T>::~SparseBuffer() {
+	release();
+}
+
+template<typename T>
+SparseBuffer<T>::SparseBuffer(const SparseBuffer<T>& other) : brickTable(other.brickTable), freeSlots(other.freeSlots) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	bricksX = other.bricksX;
+	bricksY = other.bricksY;
+	bricksZ = other.bricksZ;
+	generation = other.generation;
+	usedSlots = other.usedSlots;
+
+	for (size_t i = 0; i < other.chunks.size(); i++) {
+		size_t bytes = SPARSE_CHUNK_BRICKS * BRICK_VOXELS * sizeof(T);
+		T* chunk = static_cast<T*>(alignedAlloc(bytes));
+		memcpy(chunk, other.chunks[i], bytes);
+		chunks.push_back(chunk);
+	}
+}
+
+template<typename T>
+SparseBuffer<T>::SparseBuffer(SparseBuffer<T>&& other) : brickTable(std::move(other.brickTable)), chunks(std::move(other.chunks)), freeSlots(std::move(other.freeSlots)) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	bricksX = other.bricksX;
+	bricksY = other.bricksY;
+	bricksZ = other.bricksZ;
+	generation = other.generation;
+	usedSlots = other.usedSlots;
+
+	other.chunks.clear();
+}
+
+template<typename T>
+SparseBuffer<T>& SparseBuffer<T>::operator=(const SparseBuffer<T>& other) {
+	if (this != &other) {
+		SparseBuffer<T> copy(other);
+		*this = std::move(copy);
+	}
+
+	return *this;
+}
+
+template<typename T>
+SparseBuffer<T>& SparseBuffer<T>::operator=(SparseBuffer<T>&& other) {
+	if (this != &other) {
+		release();
+
+		dimX = other.dimX;
+		dimY = other.dimY;
+		dimZ = other.dimZ;
+		bricksX = other.bricksX;
+		bricksY = other.bricksY;
+		bricksZ = other.bricksZ;
+		generation = other.generation;
+		usedSlots = other.usedSlots;
+		brickTable = std::move(other.brickTable);
+		chunks = std::move(other.chunks);
+		freeSlots = std::move(other.freeSlots);
+
+		other.chunks.clear();
+	}
+
+	return *this;
+}
+
+template<typename T>
+void SparseBuffer<T>::release() {
+	for (size_t i = 0; i < chunks.size(); i++) {
+		alignedFree(chunks[i]);
+	}
+
+	chunks.clear();
+}
+
+template<typename T>
+uint32_t SparseBuffer<T>::allocateBrick(size_t brick) {
+	uint32_t slot;
+
+	// Reuses slots given back by clearBox() first,
+	// and grows the pool by a whole chunk when it runs out of slots
+	if (!freeSlots.empty()) {
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else {
+		if (usedSlots == chunks.size() * SPARSE_CHUNK_BRICKS) {
+			chunks.push_back(static_cast<T*>(alignedAlloc(SPARSE_CHUNK_BRICKS * BRICK_VOXELS * sizeof(T))));
+		}
+
+		slot = usedSlots++;
+	}
+
+	// Slots are reused after clear(), so they are zeroed here
+	// instead of when the chunk is allocated
+	memset(slotCells(slot), 0, BRICK_VOXELS * sizeof(T));
+	brickTable[brick].slot = slot;
+	brickTable[brick].generation = generation;
+
+	return slot;
+}
+
+template<typename T>
+const T* SparseBuffer<T>::readRow(int x, int y, T* scratch) const {
+	for (int z = 0; z < dimZ; z += BRICK_SIZE) {
+		int count = std::min(BRICK_SIZE, dimZ - z);
+		memcpy(scratch + z, &(*this)(x, y, z), count * sizeof(T));
+	}
+
+	return scratch;
+}
+
+template<typename T>
+size_t SparseBuffer<T>::memoryUsage() const {
+	return chunks.size() * SPARSE_CHUNK_BRICKS * BRICK_VOXELS * sizeof(T) + brickTable.size() * sizeof(BrickEntry);
+}
+
+template<typename T>
+void SparseBuffer<T>::clear() {
+	// Every entry is stale now, so every slot is free again
+	generation++;
+	usedSlots = 1;
+	freeSlots.clear();
+
+	// After 2^32 clears the counter wraps around, and an old entry could
+	// look current again, so every entry is marked stale by hand
+	if (generation == 0) {
+		BrickEntry empty = { 0, 0 };
+		std::fill(brickTable.begin(), brickTable.end(), empty);
+		generation = 1;
+	}
+}
+
+template<typename T>
+void SparseBuffer<T>::clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+		return;
+	}
+
+	for (int bx = minX >> BRICK_SHIFT; bx <= (maxX - 1) >> BRICK_SHIFT; bx++) {
+		for (int by = minY >> BRICK_SHIFT; by <= (maxY - 1) >> BRICK_SHIFT; by++) {
+			for (int bz = minZ >> BRICK_SHIFT; bz <= (maxZ - 1) >> BRICK_SHIFT; bz++) {
+				int x0 = bx << BRICK_SHIFT, x1 = std::min(x0 + BRICK_SIZE, dimX);
+				int y0 = by << BRICK_SHIFT, y1 = std::min(y0 + BRICK_SIZE, dimY);
+				int z0 = bz << BRICK_SHIFT, z1 = std::min(z0 + BRICK_SIZE, dimZ);
+				size_t brick = brickIndex(x0, y0, z0);
+				uint32_t slot = slotOf(brick);
+
+				// Bricks that were never written already read as zero
+				if (slot == 0) {
+					continue;
+				}
+
+				// A brick inside the box goes back to the pool
+				// (generation is never 0, so the entry is stale from now on)
+				if (minX <= x0 && x1 <= maxX && minY <= y0 && y1 <= maxY && minZ <= z0 && z1 <= maxZ) {
+					BrickEntry empty = { 0, 0 };
+					brickTable[brick] = empty;
+					freeSlots.push_back(slot);
+					continue;
+				}
+
+				int fromZ = std::max(minZ, z0), toZ = std::min(maxZ, z1);
+
+				for (int x = std::max(minX, x0); x < std::min(maxX, x1); x++) {
+					for (int y = std::max(minY, y0); y < std::min(maxY, y1); y++) {
+						memset(slotCells(slot) + brickLocalIndex(x, y, fromZ), 0, (toZ - fromZ) * sizeof(T));
+					}
+				}
+			}
+		}
+	}
+}
+
+template class SparseBuffer<float>;
+template class SparseBuffer<uint8_t>;
+template class SparseBuffer<uint16_t>;
+template class SparseBuffer<Half>;
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "brickBuffer.h"
+#include "voxelBuffer.h"
+
+// Number of bricks the pool of a SparseBuffer grows by at once
+#define SPARSE_CHUNK_BRICKS 64
+
+// 3D array of voxels of type T that only stores the bricks that were written
+// -----
+// The array is split into 8x8x8 bricks like BrickBuffer,
+// but a brick only gets memory the first time one of its cells is written.
+// A table with one entry per brick holds the slot of the brick in a pool,
+// and slot 0 is a brick of zeroes shared by every brick that was never written,
+// so reading never allocates and always finds a brick to read from.
+// The pool grows in chunks of SPARSE_CHUNK_BRICKS bricks that never move,
+// so references to cells stay valid while other bricks are allocated.
+// -----
+// Clearing is lazy: every table entry carries the generation it was written in,
+// and clear() only starts a new generation and hands the whole pool out again.
+// An entry from an older generation counts as a brick that was never written.
+// -----
+// Memory grows with the part of the array that was written
+// instead of with its bounding box, so huge mostly-empty arrays are cheap:
+// a 1024^3 array needs a 16 MB table plus 2 KB for every float brick used.
+// -----
+// Has the same accessor interface as VoxelBuffer (see BasicDensityMap),
+// except that there is no single block of memory, so span() is empty
+// Instantiated in sparseBuffer.cpp for every type in voxelTypes.h
+template<typename T>
+class SparseBuffer {
+private:
+	int dimX;
+	int dimY;
+	int dimZ;
+
+	// Number of bricks along x, y, and z
+	int bricksX;
+	int bricksY;
+	int bricksZ;
+
+	// Where a brick lives in the pool
+	struct BrickEntry {
+		// Slot of the brick in the pool
+		uint32_t slot;
+
+		// Generation the slot was handed out in
+		// The slot means nothing if this is not the current generation
+		uint32_t generation;
+	};
+
+	// Entry of every brick, indexed by brickIndex()
+	std::vector<BrickEntry> brickTable;
+
+	// The current generation, bumped by clear()
+	uint32_t generation;
+
+	// The pool, SPARSE_CHUNK_BRICKS bricks per chunk
+	std::vector<T*> chunks;
+
+	// Number of slots handed out so far, slot 0 included
+	uint32_t usedSlots;
+
+	// Slots given back by clearBox(), handed out again before new ones
+	std::vector<uint32_t> freeSlots;
+
+	// Returns the first cell of the brick in slot
+	T* slotCells(uint32_t slot) const {
+		return chunks[slot / SPARSE_CHUNK_BRICKS] + size_t(slot % SPARSE_CHUNK_BRICKS) * BRICK_VOXELS;
+	}
+
+	// Gives the brick a zero-filled slot and returns it
+	uint32_t allocateBrick(size_t brick);
+
+	void release();
+
+public:
+	SparseBuffer(int dimX, int dimY, int dimZ);
+	~SparseBuffer();
+
+	SparseBuffer(const SparseBuffer& other);
+	SparseBuffer(SparseBuffer&& other);
+	SparseBuffer& operator=(const SparseBuffer& other);
+	SparseBuffer& operator=(SparseBuffer&& other);
+
+	// Index of the brick holding (x, y, z), counting x-major
+	size_t brickIndex(int x, int y, int z) const {
+		return (size_t(x >> BRICK_SHIFT) * bricksY + (y >> BRICK_SHIFT)) * bricksZ + (z >> BRICK_SHIFT);
+	}
+
+	// Access to one cell for writing, without bounds checks
+	// Allocates the brick holding the cell if it has none yet
+	T& operator()(int x, int y, int z) {
+		size_t brick = brickIndex(x, y, z);
+		BrickEntry entry = brickTable[brick];
+		uint32_t slot = entry.slot;
+
+		if (entry.generation != generation) {
+			slot = allocateBrick(brick);
+		}
+
+		return slotCells(slot)[brickLocalIndex(x, y, z)];
+	}
+
+	// Access to one cell for reading, without bounds checks
+	// Cells in bricks that were never written are zero
+	const T& operator()(int x, int y, int z) const {
+		return slotCells(slotOf(brickIndex(x, y, z)))[brickLocalIndex(x, y, z)];
+	}
+
+	// Slot the brick reads from (0 if it was not written in this generation)
+	uint32_t slotOf(size_t brick) const {
+		BrickEntry entry = brickTable[brick];
+		return entry.generation == generation ? entry.slot : 0;
+	}
+
+	// Copies the row at (x, y) into scratch and returns scratch
+	// scratch must hold at least dimZ cells
+	const T* readRow(int x, int y, T* scratch) const;
+
+	// There is no single block of memory to look at
+	Span<T> span() { return Span<T>(); }
+	Span<const T> span() const { return Span<const T>(); }
+
+	// Number of bricks that have memory, not counting the zero brick
+	size_t allocatedBricks() const { return usedSlots - 1 - freeSlots.size(); }
+
+	// Number of bytes used by the pool and the brick table
+	size_t memoryUsage() const;
+
+	// Overwrites every cell with zero
+	// -----
+	// Takes constant time, see the top of the class.
+	// The pool is kept around so the next sweep
+	// can reuse its bricks without allocating
+	void clear();
+
+	// Overwrites every cell from (minX, minY, minZ) (inclusive)
+	// to (maxX, maxY, maxZ) (exclusive) with zero
+	// -----
+	// Bricks inside the box give their slots back to the pool,
+	// so a region that keeps moving (see BasicDensityMap::setOrigin())
+	// keeps reusing the same slots instead of growing the pool
+	void clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+};
@@ -0,0 +1,101 @@
+#include "threadPool.h"
+
+ThreadPool::ThreadPool(int threads) {
+	if (threads <= 0) {
+		threads = int(std::thread::hardware_concurrency());
+	}
+
+	task = nullptr;
+	taskCount = 0;
+	next = 0;
+	busy = 0;
+	round = 0;
+	stopping = false;
+
+	// The calling thread is one of the threads
+	for (int i = 1; i < threads; i++) {
+		workers.push_back(std::thread(&ThreadPool::work, this, i));
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+
+	wake.notify_all();
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		workers[i].join();
+	}
+}
+
+void ThreadPool::runTasks(int thread) {
+	for (int i = next++; i < taskCount; i = next++) {
+		(*task)(i, thread);
+	}
+}
+
+void ThreadPool::work(int thread) {
+	uint64_t seen = 0;
+
+	std::unique_lock<std::mutex> lock(mutex);
+
+	while (true) {
+		wake.wait(lock, [&] { return stopping || round != seen; });
+
+		if (stopping) {
+			return;
+		}
+
+		seen = round;
+
+		lock.unlock();
+		runTasks(thread);
+		lock.lock();
+
+		if (--busy == 0) {
+			done.notify_all();
+		}
+	}
+}
+
+void ThreadPool::parallelFor(int count, const std::function<void(int, int)>& task) {
+	if (count <= 0) {
+		return;
+	}
+
+	// Not worth waking anyone up for
+	if (workers.empty() || count == 1) {
+		for (int i = 0; i < count; i++) {
+			task(i, 0);
+		}
+
+		return;
+	}
+
+	std::lock_guard<std::mutex> call(callMutex);
+	std::unique_lock<std::mutex> lock(mutex);
+
+	this->task = &task;
+	taskCount = count;
+	next = 0;
+	busy = int(workers.size());
+	round++;
+
+	lock.unlock();
+	wake.notify_all();
+
+	runTasks(0);
+
+	lock.lock();
+	done.wait(lock, [&] { return busy == 0; });
+
+	this->task = nullptr;
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
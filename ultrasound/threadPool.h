@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for running loops in parallel
+// -----
+// parallelFor() hands the iterations out one at a time
+// to the workers and to the calling thread, and returns once all of them
+// are done, so it can be used like an ordinary loop.
+// The workers sleep between calls, so keeping a pool around costs nothing.
+// -----
+// Tasks must not throw, and must not call parallelFor() on the same pool.
+// Calls from different threads are run one after the other.
+class ThreadPool {
+private:
+	std::vector<std::thread> workers;
+
+	// Held for the whole of a parallelFor() call
+	std::mutex callMutex;
+
+	// Guards everything below
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// The loop being run
+	const std::function<void(int, int)>* task;
+	int taskCount;
+
+	// Next iteration to hand out
+	std::atomic<int> next;
+
+	// Number of workers still running the current loop
+	int busy;
+
+	// Bumped by every parallelFor(), so workers can tell a new loop from a spurious wake-up
+	uint64_t round;
+
+	bool stopping;
+
+	// Runs iterations until there are none left
+	void runTasks(int thread);
+
+	// Body of every worker
+	void work(int thread);
+
+public:
+	// Makes a pool that runs loops on threads threads, the calling one included
+	// (0 uses every core)
+	ThreadPool(int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+
+	// Number of threads loops run on, the calling one included
+	int getThreadCount() const { return int(workers.size()) + 1; }
+
+	// Calls task(i, thread) for every i from 0 to count - 1, in parallel
+	// -----
+	// thread is between 0 and getThreadCount() - 1 and tells
+	// which thread is running the iteration (0 is the calling thread),
+	// so tasks can keep per-thread results without locking
+	void parallelFor(int count, const std::function<void(int, int)>& task);
+
+	// The pool shared by everything that does not bring its own,
+	// made the first time it is asked for
+	static ThreadPool& shared();
+};
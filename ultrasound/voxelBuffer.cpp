@@ -0,0 +1,157 @@
+#include "voxelBuffer.h"
+#include "voxelTypes.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// Rounds n up to the next multiple of m
+static size_t roundUp(size_t n, size_t m) {
+	return (n + m - 1) / m * m;
+}
+
+void* alignedAlloc(size_t bytes) {
+	bytes = roundUp(bytes, VOXEL_ALIGNMENT);
+
+	// Nothing in the standard library before C++17 hands out
+	// memory with a custom alignment, so use the platform calls
+#ifdef _WIN32
+	void* block = _aligned_malloc(bytes, VOXEL_ALIGNMENT);
+#else
+	void* block = nullptr;
+	if (posix_memalign(&block, VOXEL_ALIGNMENT, bytes) != 0) {
+		block = nullptr;
+	}
+#endif
+
+	if (block == nullptr && bytes > 0) {
+		throw std::bad_alloc();
+	}
+
+	return block;
+}
+
+void alignedFree(void* block) {
+#ifdef _WIN32
+	_aligned_free(block);
+#else
+	free(block);
+#endif
+}
+
+template<typename T>
+VoxelBuffer<T>::VoxelBuffer(int dimX, int dimY, int dimZ) {
+	this->dimX = dimX;
+	this->dimY = dimY;
+	this->dimZ = dimZ;
+
+	rowStride = roundUp(dimZ, VOXEL_ALIGNMENT / sizeof(T));
+	sliceStride = dimY * rowStride;
+
+	allocate();
+	clear();
+}
+
+template<typename T>
+VoxelBuffer<T>::~VoxelBuffer() {
+	release();
+}
+
+template<typename T>
+VoxelBuffer<T>::VoxelBuffer(const VoxelBuffer<T>& other) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	rowStride = other.rowStride;
+	sliceStride = other.sliceStride;
+
+	allocate();
+	memcpy(voxels, other.voxels, size() * sizeof(T));
+}
+
+template<typename T>
+VoxelBuffer<T>::VoxelBuffer(VoxelBuffer<T>&& other) {
+	dimX = other.dimX;
+	dimY = other.dimY;
+	dimZ = other.dimZ;
+	rowStride = other.rowStride;
+	sliceStride = other.sliceStride;
+	voxels = other.voxels;
+
+	other.voxels = nullptr;
+}
+
+template<typename T>
+VoxelBuffer<T>& VoxelBuffer<T>::operator=(const VoxelBuffer<T>& other) {
+	if (this != &other) {
+		VoxelBuffer<T> copy(other);
+		*this = std::move(copy);
+	}
+
+	return *this;
+}
+
+template<typename T>
+VoxelBuffer<T>& VoxelBuffer<T>::operator=(VoxelBuffer<T>&& other) {
+	if (this != &other) {
+		release();
+
+		dimX = other.dimX;
+		dimY = other.dimY;
+		dimZ = other.dimZ;
+		rowStride = other.rowStride;
+		sliceStride = other.sliceStride;
+		voxels = other.voxels;
+
+		other.voxels = nullptr;
+	}
+
+	return *this;
+}
+
+template<typename T>
+void VoxelBuffer<T>::allocate() {
+	voxels = static_cast<T*>(alignedAlloc(size() * sizeof(T)));
+}
+
+template<typename T>
+void VoxelBuffer<T>::release() {
+	alignedFree(voxels);
+	voxels = nullptr;
+}
+
+template<typename T>
+void VoxelBuffer<T>::clear() {
+	// All-zero bytes are zero in every voxel type, so the whole block
+	// (padding included) can be wiped in one go
+	memset(voxels, 0, size() * sizeof(T));
+}
+
+template<typename T>
+void VoxelBuffer<T>::clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	if (minX >= maxX || minY >= maxY || minZ >= maxZ) {
+		return;
+	}
+
+	// Whole slices are one block each, padding included
+	if (minY == 0 && maxY == dimY && minZ == 0 && maxZ == dimZ) {
+		memset(voxels + index(minX, 0, 0), 0, (maxX - minX) * sliceStride * sizeof(T));
+		return;
+	}
+
+	for (int x = minX; x < maxX; x++) {
+		for (int y = minY; y < maxY; y++) {
+			memset(voxels + index(x, y, minZ), 0, (maxZ - minZ) * sizeof(T));
+		}
+	}
+}
+
+template class VoxelBuffer<float>;
+template class VoxelBuffer<uint8_t>;
+template class VoxelBuffer<uint16_t>;
+template class VoxelBuffer<Half>;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+
+// Every row of a VoxelBuffer starts on a boundary of this many bytes
+// (one cache line, which is also the width of an AVX-512 register)
+#define VOXEL_ALIGNMENT 64
+
+// Allocates bytes of memory aligned to VOXEL_ALIGNMENT
+// Throws std::bad_alloc on failure
+void* alignedAlloc(size_t bytes);
+
+// Frees memory returned by alignedAlloc()
+void alignedFree(void* block);
+
+// Non-owning view of a contiguous block of memory
+template<typename T>
+struct Span {
+	T* ptr;
+	size_t count;
+
+	Span() : ptr(nullptr), count(0) {}
+	Span(T* ptr, size_t count) : ptr(ptr), count(count) {}
+
+	T* data() const { return ptr; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+
+	T* begin() const { return ptr; }
+	T* end() const { return ptr + count; }
+
+	T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// 3D array of voxels of type T stored in one contiguous, aligned block
+// -----
+// Cells are indexed [x][y][z] like the old nested vectors,
+// so z is the fastest moving index.
+// Every row along z is padded to a multiple of VOXEL_ALIGNMENT bytes,
+// which lets SIMD loops run over a whole row without a scalar tail.
+// The padding is always zero.
+// -----
+// Instantiated in voxelBuffer.cpp for every type in voxelTypes.h
+template<typename T>
+class VoxelBuffer {
+private:
+	int dimX;
+	int dimY;
+	int dimZ;
+
+	// Distance in voxels between (x, y, z) and (x, y + 1, z)
+	size_t rowStride;
+
+	// Distance in voxels between (x, y, z) and (x + 1, y, z)
+	size_t sliceStride;
+
+	// Aligned block holding every cell (and the row padding)
+	T* voxels;
+
+	void allocate();
+	void release();
+
+public:
+	VoxelBuffer(int dimX, int dimY, int dimZ);
+	~VoxelBuffer();
+
+	VoxelBuffer(const VoxelBuffer& other);
+	VoxelBuffer(VoxelBuffer&& other);
+	VoxelBuffer& operator=(const VoxelBuffer& other);
+	VoxelBuffer& operator=(VoxelBuffer&& other);
+
+	// Position of (x, y, z) in data()
+	size_t index(int x, int y, int z) const {
+		return x * sliceStride + y * rowStride + z;
+	}
+
+	// Indexed access without bounds checks
+	T& operator()(int x, int y, int z) { return voxels[index(x, y, z)]; }
+	const T& operator()(int x, int y, int z) const { return voxels[index(x, y, z)]; }
+
+	// Pointer to the first cell of the row at (x, y)
+	T* row(int x, int y) { return voxels + index(x, y, 0); }
+	const T* row(int x, int y) const { return voxels + index(x, y, 0); }
+
+	// Returns a pointer to the row at (x, y)
+	// -----
+	// Part of the accessor interface every storage shares
+	// (see BasicDensityMap), so code can read whole rows
+	// without knowing the layout. Rows are already contiguous here,
+	// so scratch is never touched.
+	const T* readRow(int x, int y, T* /*scratch*/) const { return row(x, y); }
+
+	// Raw access to the whole block, padding included
+	T* data() { return voxels; }
+	const T* data() const { return voxels; }
+
+	// Number of voxels in data(), padding included
+	size_t size() const { return dimX * sliceStride; }
+
+	// The whole block as a span, padding included
+	Span<T> span() { return Span<T>(voxels, size()); }
+	Span<const T> span() const { return Span<const T>(voxels, size()); }
+
+	size_t getRowStride() const { return rowStride; }
+	size_t getSliceStride() const { return sliceStride; }
+
+	// Number of bytes used by the cells
+	size_t memoryUsage() const { return size() * sizeof(T); }
+
+	// Overwrites every cell with zero
+	void clear();
+
+	// Overwrites every cell from (minX, minY, minZ) (inclusive)
+	// to (maxX, maxY, maxZ) (exclusive) with zero
+	void clearBox(int minX, int minY, int minZ, int maxX, int maxY, int maxZ);
+};
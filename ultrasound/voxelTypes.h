@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+
+#include <glm/gtc/packing.hpp>
+
+// 16-bit floating point number
+// Only used for storage, all math is done with floats
+struct Half {
+	uint16_t bits;
+};
+
+// Describes how a voxel type is converted to and from
+// the floats that the rest of the program works with
+// -----
+// fromFloat() saturates, so writing a value that the type cannot hold
+// stores the closest value it can hold instead of wrapping around
+template<typename T>
+struct VoxelTraits;
+
+template<>
+struct VoxelTraits<float> {
+	static float toFloat(float v) { return v; }
+	static float fromFloat(float v) { return v; }
+};
+
+template<>
+struct VoxelTraits<uint8_t> {
+	// Densities between 0 and 1 are stored as 0 to 255
+	static float toFloat(uint8_t v) { return v * (1.0f / 255.0f); }
+
+	static uint8_t fromFloat(float v) {
+		// NaN fails this comparison too, and is stored as 0
+		if (!(v > 0.0f)) return 0;
+		if (v >= 1.0f) return 255;
+		return uint8_t(v * 255.0f + 0.5f);
+	}
+};
+
+template<>
+struct VoxelTraits<uint16_t> {
+	// Densities between 0 and 1 are stored as 0 to 65535
+	static float toFloat(uint16_t v) { return v * (1.0f / 65535.0f); }
+
+	static uint16_t fromFloat(float v) {
+		if (!(v > 0.0f)) return 0;
+		if (v >= 1.0f) return 65535;
+		return uint16_t(v * 65535.0f + 0.5f);
+	}
+};
+
+template<>
+struct VoxelTraits<Half> {
+	static float toFloat(Half v) { return glm::unpackHalf1x16(v.bits); }
+
+	static Half fromFloat(float v) {
+		// The largest finite half is 65504
+		if (!(v == v)) v = 0.0f;
+		if (v > 65504.0f) v = 65504.0f;
+		if (v < -65504.0f) v = -65504.0f;
+
+		Half h;
+		h.bits = glm::packHalf1x16(v);
+		return h;
+	}
+};